@@ -142,8 +142,10 @@ int ts3plugin_init() {
     std::string sconfigPath(configPath);
 #ifdef _WIN32
     std::string configFile(sconfigPath + "\\volumeoptions_plugin.ini");
+    std::string journalFile(sconfigPath + "\\volumeoptions_volumes.journal");
 #else
     std::string configFile(sconfigPath + "/volumeoptions_plugin.ini");
+    std::string journalFile(sconfigPath + "/volumeoptions_volumes.journal");
 #endif
     g_voptions = std::make_unique<vo::VolumeOptions>();
     if (!g_voptions)
@@ -158,6 +160,10 @@ int ts3plugin_init() {
         ;
     }
 
+    // before the first talk status starts the monitor, stranded sessions are restored when it does.
+    if (g_voptions->set_journal_file(journalFile) == 0)
+        printf("VO_PLUGIN: Error opening volumes journal, crash recovery disabled\n");
+
     return 0;  /* 0 = success, 1 = failure, -2 = failure but client will not show a "failed to load" warning */
 	/* -2 is a very special case and should only be used if a plugin displays a dialog (e.g. overlay) asking the user to disable
 	 * the plugin again, avoiding the show another dialog by the client telling the user the plugin failed to load.
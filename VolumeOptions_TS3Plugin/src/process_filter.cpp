@@ -0,0 +1,222 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Compiled session exclusion filters, see process_filter.h
+*/
+
+#include <algorithm>
+#include <deque>
+
+#include "../volumeoptions/process_filter.h"
+
+namespace vo {
+
+namespace {
+const uint32_t no_state = 0xFFFFFFFF;
+}
+
+multi_pattern_matcher::multi_pattern_matcher()
+    : m_match_all(false)
+    , m_classes(1)
+    , m_delta(1, 0)
+    , m_accept(1, 0)
+{
+    std::fill(std::begin(m_ascii_class), std::end(m_ascii_class), 0);
+}
+
+multi_pattern_matcher::multi_pattern_matcher(const std::vector<std::wstring>& patterns)
+    : m_match_all(false)
+    , m_classes(1)
+{
+    std::fill(std::begin(m_ascii_class), std::end(m_ascii_class), 0);
+
+    // Alphabet, class 0 is any character not used by the patterns.
+    std::vector<wchar_t> chars;
+    for (const auto& p : patterns)
+    {
+        if (p.empty())
+            m_match_all = true;
+        chars.insert(chars.end(), p.begin(), p.end());
+    }
+    std::sort(chars.begin(), chars.end());
+    chars.erase(std::unique(chars.begin(), chars.end()), chars.end());
+    for (wchar_t c : chars)
+    {
+        if (static_cast<uint32_t>(c) < 128)
+            m_ascii_class[c] = m_classes++;
+        else
+            m_wide_class.push_back(std::make_pair(c, m_classes++));
+    }
+
+    // Trie, missing transitions are no_state until the failure pass.
+    m_delta.assign(m_classes, no_state);
+    m_accept.assign(1, 0);
+    for (const auto& p : patterns)
+    {
+        uint32_t s = 0;
+        for (wchar_t c : p)
+        {
+            uint32_t& next = m_delta[s * m_classes + char_class(c)];
+            if (next == no_state)
+            {
+                next = static_cast<uint32_t>(m_accept.size());
+                m_accept.push_back(0);
+                m_delta.resize(m_delta.size() + m_classes, no_state);
+            }
+            s = m_delta[s * m_classes + char_class(c)]; // resize may have moved 'next'
+        }
+        m_accept[s] = 1;
+    }
+
+    // Breadth first failure links, folded into the table so searching never follows them.
+    std::vector<uint32_t> fail(m_accept.size(), 0);
+    std::deque<uint32_t> queue;
+    for (uint32_t c = 0; c < m_classes; ++c)
+    {
+        uint32_t& next = m_delta[c];
+        if (next == no_state)
+            next = 0;
+        else
+            queue.push_back(next);
+    }
+    while (!queue.empty())
+    {
+        uint32_t s = queue.front();
+        queue.pop_front();
+        for (uint32_t c = 0; c < m_classes; ++c)
+        {
+            uint32_t& next = m_delta[s * m_classes + c];
+            uint32_t fallback = m_delta[fail[s] * m_classes + c];
+            if (next == no_state)
+            {
+                next = fallback;
+            }
+            else
+            {
+                fail[next] = fallback;
+                m_accept[next] |= m_accept[fallback];
+                queue.push_back(next);
+            }
+        }
+    }
+}
+
+uint32_t multi_pattern_matcher::char_class(wchar_t c) const
+{
+    if (static_cast<uint32_t>(c) < 128)
+        return m_ascii_class[c];
+
+    auto it = std::lower_bound(m_wide_class.begin(), m_wide_class.end(), std::make_pair(c, uint32_t(0)));
+    return ((it != m_wide_class.end()) && (it->first == c)) ? it->second : 0;
+}
+
+bool multi_pattern_matcher::search(const std::wstring& text) const
+{
+    if (m_match_all)
+        return true;
+    if (m_accept.size() <= 1)
+        return false;
+
+    uint32_t s = 0;
+    for (wchar_t c : text)
+    {
+        s = m_delta[s * m_classes + char_class(c)];
+        if (m_accept[s])
+            return true;
+    }
+
+    return false;
+}
+
+
+process_filter::process_filter()
+    : m_exclude_own_process(false)
+    , m_own_pid(0)
+    , m_use_included_filter(false)
+{}
+
+process_filter::process_filter(const monitor_settings& settings, const unsigned long own_pid)
+    : m_exclude_own_process(settings.exclude_own_process)
+    , m_own_pid(own_pid)
+    , m_use_included_filter(settings.use_included_filter)
+{
+    const auto& pids = m_use_included_filter ? settings.included_pids : settings.excluded_pids;
+    const auto& names = m_use_included_filter ? settings.included_process : settings.excluded_process;
+
+    // std::set is already sorted.
+    m_pids.assign(pids.begin(), pids.end());
+
+    std::vector<std::wstring> patterns;
+    patterns.reserve(names.size());
+    for (const auto& n : names)
+        patterns.push_back(fold_case(n));
+    m_names = multi_pattern_matcher(patterns);
+}
+
+bool process_filter::has_pid(const unsigned long pid) const
+{
+    return std::binary_search(m_pids.begin(), m_pids.end(), pid);
+}
+
+bool process_filter::same_pid_verdict(const unsigned long pid_a, const unsigned long pid_b) const
+{
+    if (pid_a == pid_b)
+        return true;
+    if (m_exclude_own_process && ((m_own_pid == pid_a) || (m_own_pid == pid_b)))
+        return false;
+    return has_pid(pid_a) == has_pid(pid_b);
+}
+
+bool process_filter::same_filters(const monitor_settings& a, const monitor_settings& b)
+{
+    return (a.exclude_own_process == b.exclude_own_process) &&
+        (a.use_included_filter == b.use_included_filter) &&
+        (a.excluded_pids == b.excluded_pids) &&
+        (a.excluded_process == b.excluded_process) &&
+        (a.included_pids == b.included_pids) &&
+        (a.included_process == b.included_process);
+}
+
+bool process_filter::is_excluded(const unsigned long pid, const interned_wstring& sid) const
+{
+    if (m_exclude_own_process && (m_own_pid == pid))
+        return true;
+
+    if (sid.str().empty())
+        return false;
+
+    if (!m_use_included_filter)
+        return has_pid(pid) || m_names.search(sid.lower());
+    else
+        return !(has_pid(pid) || m_names.search(sid.lower()));
+}
+
+} // end namespace vo
@@ -38,8 +38,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma warning(pop)
 #endif
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <future>
 #include <iostream>
 
 #include "stdio.h"
@@ -72,26 +74,53 @@ VolumeOptions::VolumeOptions(const vo::volume_options_settings& settings)
     // nothing to parse from here, audiomonitor settings will be parsed when set.
 
     m_paudio_monitor->SetSettings(m_vo_settings.monitor_settings);
+    publish_settings();
 }
 
 /* 
     Basic constructor, will load default settings always. 
 */
 VolumeOptions::VolumeOptions()
-    : m_someone_enabled_is_talking(false)
+    : m_enabled_channels(0)
     , m_status(status::ENABLED)
+    , m_someone_enabled_is_talking(false)
+    , m_hold_work(new boost::asio::io_service::work(m_hold_io))
+    , m_hold_timer(m_hold_io)
+    , m_talk_events(1024)
+    , m_talk_drain_pending(false)
+    , m_talk_events_pushed(0)
+    , m_talk_overflows(0)
+    , m_talk_drains(0)
+    , m_monitor_request(monitor_request_t::NONE)
+    , m_monitor_requests(0)
+    , m_monitor_superseded(0)
 {
-
-    m_clients_talking.resize(2); // will hold VolumeOptions::status, 0 or 1
-    m_channels_with_activity.resize(2); // will hold VolumeOptions::status, 0 or 1
-
     // Create the audio monitor and send settings to parse, it will return parsed settings.
     if (!m_paudio_monitor)
         m_paudio_monitor = AudioMonitor::create();
+
+    publish_settings();
+
+    // started last, an exception above must not leave a joinable thread behind.
+    m_hold_thread = std::thread([this]() { m_hold_io.run(); });
 }
 
 VolumeOptions::~VolumeOptions()
 {
+    // No talk hysteresis deadlines from now on.
+    m_hold_work.reset();
+    m_hold_io.stop();
+    if (m_hold_thread.joinable())
+        m_hold_thread.join();
+
+    // Talk events and a monitor request m_hold_thread did not get to, a pending Pause or Stop must not be lost.
+    {
+        std::lock_guard<std::recursive_mutex> guard(m_mutex);
+        if (pop_talk_events())
+            apply_status();
+    }
+    apply_monitor_request();
+
     // Save settings on exit.
     if (!m_config_filename.empty())
         save_settings_to_file(m_config_filename);
@@ -112,6 +141,26 @@ void VolumeOptions::set_config_file(const std::string &configFile)
     m_config_filename = configFile;
 }
 
+/*
+    Opens the default volumes journal, absolute path to file.
+
+    Sessions left ducked by a crash get their default volume back when the monitor saves them again.
+    Returns 0 if the file can not be mapped, VolumeOptions works without a journal.
+*/
+int VolumeOptions::set_journal_file(const std::string &journalFile)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    std::shared_ptr<volume_journal> journal = std::make_shared<volume_journal>();
+    if (!journal->open(journalFile))
+        return 0;
+
+    m_journal = journal;
+    m_paudio_monitor->SetJournal(m_journal);
+
+    return 1;
+}
+
 /*
     Tries to open configFile and set settings.
 
@@ -167,6 +216,7 @@ int VolumeOptions::set_settings_from_file(const std::string &configFile, bool cr
     in.close();
 
     m_paudio_monitor->SetSettings(m_vo_settings.monitor_settings);
+    publish_settings();
 
     return ret;
 }
@@ -190,6 +240,14 @@ void VolumeOptions::create_config_file(std::fstream& in)
         "# ignore volume change when we talk ? default 1(true)\n"
         "exclude_own_client = 1\n"
         "\n"
+        "# talk hysteresis as milliseconds, for voice activation flapping, default 0ms (off)\n"
+        "# duck_delay: talk time before reducing volume, shorter talks are ignored\n"
+        "# min_duck_time: once reduced keep it at least this long\n"
+        "# release_hold: silence time before restoring volume, talking again inside it keeps it reduced\n"
+        "duck_delay = 0\n"
+        "min_duck_time = 0\n"
+        "release_hold = 0\n"
+        "\n"
         "\n"
         "\n"
         "[AudioSessions]\n"
@@ -206,6 +264,14 @@ void VolumeOptions::create_config_file(std::fstream& in)
         "# recommended on \"1\" use \"0\" only in special cases default 1(true)\n"
         "change_only_active_sessions = 1\n"
         "\n"
+        "# volume ramp times as milliseconds, 0 = instant change default 0ms\n"
+        "# attack: down to reduced volume, release: back to default volume (after vol_up_delay)\n"
+        "vol_attack = 0\n"
+        "vol_release = 0\n"
+        "\n"
+        "# 0 = linear ramp, 1 = ramp linear in dB (sounds smoother) default 1(true)\n"
+        "vol_ramp_db = 1\n"
+        "\n"
         "\n"
         "\n"
         "[AudioMonitor]\n"
@@ -213,6 +279,12 @@ void VolumeOptions::create_config_file(std::fstream& in)
         "# this should be 1 always default 1(true)\n"
         "exclude_own_process = 1\n"
         "\n"
+        "# volume ramps update period as milliseconds (min 5) default 20ms\n"
+        "ramp_interval = 20\n"
+        "\n"
+        "# max volume ramp writes per second for all sessions, 0 = no limit default 500\n"
+        "max_volume_writes = 500\n"
+        "\n"
         "# excluded_pids and included_pids takes a list of process IDs\n"
         "# excluded_process and included_process takes a list of executable names or paths\n"
         "#\n"
@@ -233,8 +305,19 @@ void VolumeOptions::create_config_file(std::fstream& in)
         "included_process =\n"
         "\n"
         "\n"
-        "# takes a list of pairs \"process:volume\" separed by \";\" NOTE: NOT IMPLEMENTED YET.\n"
-        "#volume_list = mymusic.exe:0.4; firefox.exe:0.8\n";
+        "\n"
+        "# application profiles, a section per executable name (case insensitive) with its own session settings.\n"
+        "# keys not given take the [AudioSessions] value.\n"
+        "#\n"
+        "# Example:\n"
+        "# [app:mymusic.exe]\n"
+        "# vol_reduction = 0.8\n"
+        "# vol_as_percentage = 1\n"
+        "# vol_up_delay = 1500\n"
+        "# change_only_active_sessions = 1\n"
+        "# vol_attack = 200\n"
+        "# vol_release = 600\n"
+        "# vol_ramp_db = 1\n";
 
 }
 
@@ -290,6 +373,32 @@ T ini_put_or_get(boost::property_tree::ptree& pt, const std::string& path, const
     return origin_value;
 }
 
+// ini section of each application profile, followed by its executable name.
+const std::string app_section_prefix = "app:";
+
+/*
+    Application profile section to settings, missing keys are put with the origin_settings value.
+*/
+session_settings parse_profile_section(boost::property_tree::ptree& section, const session_settings& origin_settings)
+{
+    session_settings profile = origin_settings;
+
+    profile.vol_reduction = ini_put_or_get<float>(section, "vol_reduction", origin_settings.vol_reduction);
+    profile.vol_up_delay = std::chrono::milliseconds(ini_put_or_get<std::chrono::milliseconds::rep>(section,
+        "vol_up_delay", origin_settings.vol_up_delay.count()));
+    profile.treat_vol_as_percentage = ini_put_or_get<bool>(section, "vol_as_percentage", origin_settings.treat_vol_as_percentage);
+    profile.change_only_active_sessions = ini_put_or_get<bool>(section, "change_only_active_sessions",
+        origin_settings.change_only_active_sessions);
+    profile.vol_attack = std::chrono::milliseconds(ini_put_or_get<std::chrono::milliseconds::rep>(section,
+        "vol_attack", origin_settings.vol_attack.count()));
+    profile.vol_release = std::chrono::milliseconds(ini_put_or_get<std::chrono::milliseconds::rep>(section,
+        "vol_release", origin_settings.vol_release.count()));
+    const bool ramp_db = ini_put_or_get<bool>(section, "vol_ramp_db", origin_settings.ramp_curve == ramp_curve_t::DB);
+    profile.ramp_curve = ramp_db ? ramp_curve_t::DB : ramp_curve_t::LINEAR;
+
+    return profile;
+}
+
 /*
     Will parse ptree to settings or origin_settings to ptree.
 
@@ -306,6 +415,9 @@ volume_options_settings VolumeOptions::parse_ptree(boost::property_tree::ptree&
 
     volume_options_settings parsed_settings;
 
+    // an empty ptree is being filled from origin_settings, else it was read from a file.
+    const bool from_file = !pt.empty();
+
     // settings shortcuts
     vo::session_settings& ses_settings = parsed_settings.monitor_settings.ses_global_settings;
     vo::monitor_settings& mon_settings = parsed_settings.monitor_settings;
@@ -323,6 +435,15 @@ volume_options_settings VolumeOptions::parse_ptree(boost::property_tree::ptree&
     // bool: do we exclude ourselfs?
     parsed_settings.exclude_own_client = ini_put_or_get<bool>(pt, "plugin.exclude_own_client", origin_settings.exclude_own_client);
 
+    // long long: talk hysteresis, milliseconds.
+    std::chrono::milliseconds::rep _hold_milliseconds;
+    _hold_milliseconds = ini_put_or_get<std::chrono::milliseconds::rep>(pt, "plugin.duck_delay", origin_settings.duck_delay.count());
+    parsed_settings.duck_delay = std::chrono::milliseconds(std::max<std::chrono::milliseconds::rep>(_hold_milliseconds, 0));
+    _hold_milliseconds = ini_put_or_get<std::chrono::milliseconds::rep>(pt, "plugin.min_duck_time", origin_settings.min_duck_time.count());
+    parsed_settings.min_duck_time = std::chrono::milliseconds(std::max<std::chrono::milliseconds::rep>(_hold_milliseconds, 0));
+    _hold_milliseconds = ini_put_or_get<std::chrono::milliseconds::rep>(pt, "plugin.release_hold", origin_settings.release_hold.count());
+    parsed_settings.release_hold = std::chrono::milliseconds(std::max<std::chrono::milliseconds::rep>(_hold_milliseconds, 0));
+
 
     // ------ Session Settings
 
@@ -340,12 +461,29 @@ volume_options_settings VolumeOptions::parse_ptree(boost::property_tree::ptree&
     // bool: Change vol only to active audio sessions? recommended
     ses_settings.change_only_active_sessions = ini_put_or_get<bool>(pt, "AudioSessions.change_only_active_sessions", def_ses_settings.change_only_active_sessions);
 
+    // long long: volume ramp times, milliseconds.
+    _delay_milliseconds = ini_put_or_get<std::chrono::milliseconds::rep>(pt, "AudioSessions.vol_attack", def_ses_settings.vol_attack.count());
+    ses_settings.vol_attack = std::chrono::milliseconds(_delay_milliseconds);
+    _delay_milliseconds = ini_put_or_get<std::chrono::milliseconds::rep>(pt, "AudioSessions.vol_release", def_ses_settings.vol_release.count());
+    ses_settings.vol_release = std::chrono::milliseconds(_delay_milliseconds);
+
+    // bool: ramp curve, 1 dB, 0 linear
+    bool ramp_db = ini_put_or_get<bool>(pt, "AudioSessions.vol_ramp_db", def_ses_settings.ramp_curve == ramp_curve_t::DB);
+    ses_settings.ramp_curve = ramp_db ? ramp_curve_t::DB : ramp_curve_t::LINEAR;
+
 
     // ------ Monitor Settings
 
     // bool: Dont know why but... yep..  1 enable, 0 disable
     mon_settings.exclude_own_process = ini_put_or_get<bool>(pt, "AudioMonitor.exclude_own_process", def_mon_settings.exclude_own_process);
 
+    // long long: ramps update period, milliseconds.
+    _delay_milliseconds = ini_put_or_get<std::chrono::milliseconds::rep>(pt, "AudioMonitor.ramp_interval", def_mon_settings.ramp_interval.count());
+    mon_settings.ramp_interval = std::chrono::milliseconds(_delay_milliseconds);
+
+    // unsigned: ramp volume writes per second cap
+    mon_settings.max_volume_writes = ini_put_or_get<unsigned>(pt, "AudioMonitor.max_volume_writes", def_mon_settings.max_volume_writes);
+
     // i know, this is a bit messy and error prone, but i think is readable.
     std::string included_process_list, def_included_process_list;
     std::string excluded_process_list, def_excluded_process_list;
@@ -379,6 +517,38 @@ volume_options_settings VolumeOptions::parse_ptree(boost::property_tree::ptree&
     parse_pid_list(included_pid_list, mon_settings.included_pids);
     parse_pid_list(excluded_pid_list, mon_settings.excluded_pids);
 
+
+    // ------ Application profiles, a [app:<executable name>] section each
+
+    // A file without profile sections has none, removing a section removes its profile.
+    // Keys missing in a section take the global session settings above.
+    mon_settings.ses_individual_settings.clear();
+    if (from_file)
+    {
+        for (auto& section : pt)
+        {
+            if (section.first.compare(0, app_section_prefix.size(), app_section_prefix) != 0)
+                continue;
+
+            std::string pname(section.first.substr(app_section_prefix.size()));
+            boost::algorithm::trim(pname);
+            if (pname.empty())
+                continue;
+
+            dprintf("parse_ptree: application profile: %s\n", pname.c_str());
+            mon_settings.ses_individual_settings[utf8_to_wstring(pname)] = parse_profile_section(section.second, ses_settings);
+        }
+    }
+    else
+    {
+        for (const auto& profile : def_mon_settings.ses_individual_settings)
+        {
+            ptree section;
+            mon_settings.ses_individual_settings[profile.first] = parse_profile_section(section, profile.second);
+            pt.push_back(ptree::value_type(app_section_prefix + wstring_to_utf8(profile.first), section));
+        }
+    }
+
 #ifdef _DEBUG
     dprintf("\n\n\n\n");
     for (auto& section : pt)
@@ -483,6 +653,23 @@ void VolumeOptions::set_settings(vo::volume_options_settings& settings)
     m_paudio_monitor->SetSettings(settings.monitor_settings);
 
     m_vo_settings = settings;
+    publish_settings();
+}
+
+/*
+    Applies m_vo_settings plugin side and replaces the settings snapshot readers get.
+    Call it with m_mutex held after every m_vo_settings change.
+*/
+void VolumeOptions::publish_settings()
+{
+    talk_hysteresis::timing timing;
+    timing.duck_delay = m_vo_settings.duck_delay;
+    timing.min_duck = m_vo_settings.min_duck_time;
+    timing.release_hold = m_vo_settings.release_hold;
+    m_talk_hold.set_timing(timing);
+
+    std::atomic_store(&m_settings_snapshot,
+        settings_snapshot(std::make_shared<vo::volume_options_settings>(m_vo_settings)));
 }
 
 /*
@@ -490,9 +677,7 @@ void VolumeOptions::set_settings(vo::volume_options_settings& settings)
 */
 float VolumeOptions::get_global_volume_reduction() const
 {
-    std::lock_guard<std::recursive_mutex> guard(m_mutex);
-
-    // gets the global vol reduction.
+    // gets the global vol reduction, AudioMonitor publishes it, no need to lock.
     return m_paudio_monitor->GetVolumeReductionLevel();
 }
 
@@ -505,7 +690,7 @@ void VolumeOptions::restore_default_volume()
 
     printf("VO_PLUGIN: Forcing restore per app user default volume.\n");
 
-    m_paudio_monitor->Stop();
+    request_monitor(monitor_request_t::STOP);
 }
 
 /* 
@@ -522,11 +707,13 @@ void VolumeOptions::reset_data() // Not used
     reset_all_clients_settings();
     reset_all_channels_settings();
 
-    if (!m_clients_talking.empty())
-        m_clients_talking.clear();
+    m_talkers.clear();
+    m_channels_with_activity.clear();
+    m_enabled_channels = 0;
 
-    if (!m_channels_with_activity.empty())
-        m_channels_with_activity.clear();
+    m_someone_enabled_is_talking = false;
+    m_talk_hold.reset(false, std::chrono::steady_clock::now());
+    arm_hold_timer();
 
     VolumeOptions::restore_default_volume();
 }
@@ -539,46 +726,68 @@ void VolumeOptions::set_status(const status newstatus)
 
     // Reenable AudioMonitor only if someone non disabled is currently talking
     if (m_someone_enabled_is_talking && (newstatus == status::ENABLED) && (m_status == status::DISABLED))
-        m_paudio_monitor->Start();
+    {
+        request_monitor(monitor_request_t::START);
+        m_talk_hold.reset(true, std::chrono::steady_clock::now());
+    }
 
-    // Stop AudioMonitor only if someone non disabled is currently talking
-    if (m_someone_enabled_is_talking && (newstatus == status::DISABLED) && (m_status == status::ENABLED))
-        m_paudio_monitor->Stop();
+    // Stop AudioMonitor only if it is ducking, someone non disabled is talking or release_hold is running
+    if (m_talk_hold.ducked() && (newstatus == status::DISABLED) && (m_status == status::ENABLED))
+        request_monitor(monitor_request_t::STOP);
+
+    if (newstatus == status::DISABLED)
+        m_talk_hold.reset(false, std::chrono::steady_clock::now());
+    arm_hold_timer();
 
     m_status = newstatus;
 }
 
 vo::volume_options_settings VolumeOptions::get_current_settings() const
 {
-    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+    return *get_settings_snapshot();
+}
 
-    return m_vo_settings;
+/*
+    Current settings for readers on other threads (GUI, info frame), no locks taken.
+*/
+VolumeOptions::settings_snapshot VolumeOptions::get_settings_snapshot() const
+{
+    return std::atomic_load(&m_settings_snapshot);
 }
 
 VolumeOptions::status VolumeOptions::get_status() const
+{
+    return m_status; // std::atomic
+}
+
+/*
+    Talk hysteresis counters, how many volume passes flapping talk status did not cause.
+*/
+talk_hysteresis::stats VolumeOptions::get_talk_stats() const
 {
     std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
-    return m_status;
+    return m_talk_hold.get_stats();
 }
 
-VolumeOptions::status VolumeOptions::get_channel_status(const uniqueServerID_t uniqueServerID, const channelID_t nonunique_channelID) const
+VolumeOptions::status VolumeOptions::get_channel_status(const uniqueServerID_t& uniqueServerID, const channelID_t nonunique_channelID) const
 {
     std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
-    uniqueChannelID_t uniqueChannelID(get_unique_channelid(uniqueServerID, nonunique_channelID));
-
-    if (m_ignored_channels.count(uniqueChannelID))
+    // a server never seen has no disabled channels.
+    const talk_key_t server = m_server_keys.find(uniqueServerID);
+    if ((server != invalid_talk_key) && m_ignored_channels.count(channel_key(server, nonunique_channelID)))
         return DISABLED;
 
     return ENABLED;
 }
 
-VolumeOptions::status VolumeOptions::get_client_status(const uniqueClientID_t clientID) const
+VolumeOptions::status VolumeOptions::get_client_status(const uniqueClientID_t& clientID) const
 {
     std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
-    if (m_ignored_clients.count(clientID))
+    const talk_key_t client = m_client_keys.find(clientID);
+    if ((client != invalid_talk_key) && m_ignored_clients.count(client))
         return DISABLED;
 
     return ENABLED;
@@ -598,21 +807,16 @@ void VolumeOptions::reset_all_channels_settings()
         return;
     }
 
-    m_ignored_channels.clear();
-
-    // Now move all disabled channels currently with activity back to enabled.
-    if (!m_channels_with_activity[DISABLED].empty())
+    // Disabled channels with enabled talkers count as enabled again.
+    for (const auto& channel : m_ignored_channels)
     {
-        // move all channels
-        for (auto it : m_channels_with_activity[DISABLED])
-        {
-            m_channels_with_activity[ENABLED][it.first] =
-                std::move(m_channels_with_activity[DISABLED][it.first]);
-        }
-
-        m_channels_with_activity[DISABLED].clear();
+        auto it = m_channels_with_activity.find(channel);
+        if ((it != m_channels_with_activity.end()) && it->second.enabled_talkers)
+            m_enabled_channels++;
     }
 
+    m_ignored_channels.clear();
+
     dprintf("VO_PLUGIN: All channels settings cleared.\n");
 
     // Update statuses
@@ -633,20 +837,16 @@ void VolumeOptions::reset_all_clients_settings()
         return;
     }
 
-    m_ignored_clients.clear();
-
-    // Now move all currently disabled talking clients back to enabled.
-    if (!m_clients_talking[DISABLED].empty())
+    // Disabled clients currently talking count as enabled talkers of their channel again.
+    for (const auto client : m_ignored_clients)
     {
-        // move all clients
-        for (auto client : m_clients_talking[DISABLED])
-        {
-            m_clients_talking[ENABLED].insert(client);
-        }
-
-        m_channels_with_activity[DISABLED].clear();
+        auto talker = m_talkers.find(client);
+        if (talker != m_talkers.end())
+            shift_enabled_talkers(talker->second, m_channels_with_activity[talker->second], true);
     }
 
+    m_ignored_clients.clear();
+
     dprintf("VO_PLUGIN: All clients settings cleared.\n");
 
     // Update statuses
@@ -657,12 +857,13 @@ void VolumeOptions::reset_all_clients_settings()
 /*
     TS3 doesnt provide a unique channel id because it always belongs to a server, here we make a unique id
         from these two elements, unique virtual server id plus local channel id.
+    For messages, talk state uses channel_key instead.
 */
 inline VolumeOptions::uniqueChannelID_t VolumeOptions::get_unique_channelid(const uniqueServerID_t& uniqueServerID,
     const channelID_t& nonunique_channelID) const
 {
     // combine unique serverID with nonunique_channelid as a string to make a uniqueChannelID (somewhat)
-    return uniqueServerID + "-" + std::to_string(nonunique_channelID); // Profiler only hot zone ~6%
+    return uniqueServerID + "-" + std::to_string(nonunique_channelID);
 }
 
 /*
@@ -670,11 +871,12 @@ inline VolumeOptions::uniqueChannelID_t VolumeOptions::get_unique_channelid(cons
 
     We need the unique server ID from where this channel is.
 */
-void VolumeOptions::set_channel_status(const uniqueServerID_t uniqueServerID, const channelID_t channelID,
+void VolumeOptions::set_channel_status(const uniqueServerID_t& uniqueServerID, const channelID_t channelID,
     const status s)
 {
     std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
+    const channel_key channel(m_server_keys.intern(uniqueServerID), channelID);
     uniqueChannelID_t uniqueChannelID(get_unique_channelid(uniqueServerID, channelID));
 
     // Move channels from containers to tag them if they have activity (someone inside the channel is talking)
@@ -682,45 +884,37 @@ void VolumeOptions::set_channel_status(const uniqueServerID_t uniqueServerID, co
     if (s == status::DISABLED)
     {
         // if already ignored return
-        if (m_ignored_channels.count(uniqueChannelID))
+        if (m_ignored_channels.count(channel))
         {
-            printf("VO_PLUGIN: Channel %s Status: Already Disabled\n", uniqueChannelID.c_str());
+            dprintf("VO_PLUGIN: Channel %s Status: Already Disabled\n", uniqueChannelID.c_str());
             return;
         }
 
-        m_ignored_channels.insert(uniqueChannelID);
+        m_ignored_channels.insert(channel);
 
-        // if channel currently has activity move it and all his clients to disabled.
-        if (m_channels_with_activity[ENABLED].count(uniqueChannelID))
-        {
-            // move it.
-            m_channels_with_activity[DISABLED][uniqueChannelID] =
-                std::move(m_channels_with_activity[ENABLED][uniqueChannelID]);
-            m_channels_with_activity[ENABLED].erase(uniqueChannelID);
-        }
+        // if enabled clients are talking in it, one less enabled channel.
+        auto it = m_channels_with_activity.find(channel);
+        if ((it != m_channels_with_activity.end()) && it->second.enabled_talkers)
+            m_enabled_channels--;
     }
     if (s == status::ENABLED)
     {
         // if already enabled return
-        if (!m_ignored_channels.count(uniqueChannelID))
+        if (!m_ignored_channels.count(channel))
         {
-            printf("VO_PLUGIN: Channel %s Status: Already Enabled\n", uniqueChannelID.c_str());
+            dprintf("VO_PLUGIN: Channel %s Status: Already Enabled\n", uniqueChannelID.c_str());
             return;
         }
 
-        m_ignored_channels.erase(uniqueChannelID);
+        m_ignored_channels.erase(channel);
 
-        // Now move the channel and and all his clients back to enabled if currently has activity.
-        if (m_channels_with_activity[DISABLED].count(uniqueChannelID))
-        {
-            // move it.
-            m_channels_with_activity[ENABLED][uniqueChannelID] =
-                std::move(m_channels_with_activity[DISABLED][uniqueChannelID]);
-            m_channels_with_activity[DISABLED].erase(uniqueChannelID);
-        }
+        // if enabled clients are talking in it, one more enabled channel.
+        auto it = m_channels_with_activity.find(channel);
+        if ((it != m_channels_with_activity.end()) && it->second.enabled_talkers)
+            m_enabled_channels++;
     }
 
-    printf("VO_PLUGIN: Channel %s Status: %s\n", uniqueChannelID.c_str(),
+    dprintf("VO_PLUGIN: Channel %s Status: %s\n", uniqueChannelID.c_str(),
         s == status::DISABLED ? "Disabled" : "Enabled");
 
     // Update statuses
@@ -730,98 +924,217 @@ void VolumeOptions::set_channel_status(const uniqueServerID_t uniqueServerID, co
 /*
     Marks clients as disabled for auto volume changes when volumeoptions is running.
 */
-void VolumeOptions::set_client_status(const uniqueClientID_t uniqueClientID, const status s)
+void VolumeOptions::set_client_status(const uniqueClientID_t& uniqueClientID, const status s)
 {
     std::lock_guard<std::recursive_mutex> guard(m_mutex);
 
+    const talk_key_t client = m_client_keys.intern(uniqueClientID);
+
     // Switch clients from containers to tag them if they are talking.
 
     if (s == status::DISABLED)
     {
         // if already ignored return
-        if (m_ignored_clients.count(uniqueClientID))
+        if (m_ignored_clients.count(client))
         {
-            printf("VO_PLUGIN: Client %s Status: Already Disabled\n", uniqueClientID.c_str());
+            dprintf("VO_PLUGIN: Client %s Status: Already Disabled\n", uniqueClientID.c_str());
             return;
         }
 
-        m_ignored_clients.insert(uniqueClientID);
+        m_ignored_clients.insert(client);
 
-        // Move client to disabled status if currently talking.
-        if (m_clients_talking[ENABLED].count(uniqueClientID))
-        {
-            // move it.
-            m_clients_talking[ENABLED].erase(uniqueClientID);
-            m_clients_talking[DISABLED].insert(uniqueClientID);
-        }
+        // if currently talking, one less enabled talker in its channel.
+        auto talker = m_talkers.find(client);
+        if (talker != m_talkers.end())
+            shift_enabled_talkers(talker->second, m_channels_with_activity[talker->second], false);
     }
     if (s == status::ENABLED)
     {
         // if already enabled return
-        if (!m_ignored_clients.count(uniqueClientID))
+        if (!m_ignored_clients.count(client))
         {
-            printf("VO_PLUGIN: Client %s Status: Already Enabled\n", uniqueClientID.c_str());
+            dprintf("VO_PLUGIN: Client %s Status: Already Enabled\n", uniqueClientID.c_str());
             return;
         }
 
-        m_ignored_clients.erase(uniqueClientID);
+        m_ignored_clients.erase(client);
 
-        // Now move client back to enabled if currently talking
-        if (m_clients_talking[DISABLED].count(uniqueClientID))
-        {
-            // move it.
-            m_clients_talking[DISABLED].erase(uniqueClientID);
-            m_clients_talking[ENABLED].insert(uniqueClientID);
-        }
+        // if currently talking, one more enabled talker in its channel.
+        auto talker = m_talkers.find(client);
+        if (talker != m_talkers.end())
+            shift_enabled_talkers(talker->second, m_channels_with_activity[talker->second], true);
     }
 
-    printf("VO_PLUGIN: Client %s Status: %s\n", uniqueClientID.c_str(),
+    dprintf("VO_PLUGIN: Client %s Status: %s\n", uniqueClientID.c_str(),
         s == status::DISABLED ? "Disabled" : "Enabled");
 
     // Update statuses
     apply_status();
 }
 
+/*
+    Adds or removes a talker of the channel, activity is dropped with its last talker.
+*/
+void VolumeOptions::add_channel_talker(const channel_key& channel, const bool enabled_client)
+{
+    channel_activity& activity = m_channels_with_activity[channel];
+
+    activity.talkers++;
+    if (enabled_client)
+        shift_enabled_talkers(channel, activity, true);
+}
+
+void VolumeOptions::remove_channel_talker(const channel_key& channel, const bool enabled_client)
+{
+    auto it = m_channels_with_activity.find(channel);
+    if (it == m_channels_with_activity.end())
+        return;
+
+    if (enabled_client)
+        shift_enabled_talkers(channel, it->second, false);
+    if (--it->second.talkers == 0)
+        m_channels_with_activity.erase(it);
+}
+
+/*
+    One more (enable) or one less enabled talker in the channel.
+    An enabled channel gaining its first or losing its last enabled talker changes m_enabled_channels.
+*/
+void VolumeOptions::shift_enabled_talkers(const channel_key& channel, channel_activity& activity, const bool enable)
+{
+    const bool had_enabled_talkers = (activity.enabled_talkers != 0);
+    if (enable)
+        activity.enabled_talkers++;
+    else
+        activity.enabled_talkers--;
+
+    if (((activity.enabled_talkers != 0) != had_enabled_talkers) && !m_ignored_channels.count(channel))
+    {
+        if (had_enabled_talkers)
+            m_enabled_channels--;
+        else
+            m_enabled_channels++;
+    }
+}
+
 /*
     Starts or stops audio monitor based on ts3 talking statuses.
 
     If none of the enabled clients/channels are talking turn off audio monitor.
+    The predicate is a counter kept by every talk and status change, AudioMonitor is only asked to change when it
+        flips (request_monitor).
+    Transitions go through m_talk_hold first, with hysteresis settings a start or stop can be delayed or
+        cancelled, a delayed one runs from on_hold_timer.
 */
 int VolumeOptions::apply_status()
 {
     int r = 1;
 
-    // if last client non disabled stoped talking, restore sounds. 
-    if ( m_clients_talking[ENABLED].empty() || m_channels_with_activity[ENABLED].empty() ) 
+    // if last client non disabled stoped talking in a non disabled channel, restore sounds.
+    const bool someone_enabled_is_talking = (m_enabled_channels != 0);
+
+    if (someone_enabled_is_talking != m_someone_enabled_is_talking)
     {
         if (m_status == status::ENABLED)
         {
-            if (m_paudio_monitor->GetStatus() != AudioMonitor::monitor_status_t::PAUSED) // so we dont repeat it.
-            {
-                dprintf("VO_PLUGIN: Audio Monitor Paused, restoring Sessions to user default volume...\n");
-                r = m_paudio_monitor->Pause();
-                //m_paudio_monitor->Stop();
-            }
+            r = run_talk_action(m_talk_hold.update(someone_enabled_is_talking, std::chrono::steady_clock::now()));
+            arm_hold_timer();
         }
-        m_someone_enabled_is_talking = false; // excluding disabled
+        m_someone_enabled_is_talking = someone_enabled_is_talking;
     }
-    else // someone non disabled is talking
+    return r;
+}
+
+int VolumeOptions::run_talk_action(const talk_hysteresis::action_t action)
+{
+    if (action == talk_hysteresis::action_t::RELEASE)
+        request_monitor(monitor_request_t::PAUSE);
+    else if (action == talk_hysteresis::action_t::DUCK)
+        request_monitor(monitor_request_t::START);
+    return 1;
+}
+
+/*
+    Asks m_hold_thread to start, pause or stop AudioMonitor, any thread, never blocks.
+
+    Only the latest request is kept, one made before m_hold_thread got to the previous one replaces it
+        (a duck quickly followed by a release only pauses, if the monitor is not already paused).
+*/
+void VolumeOptions::request_monitor(const monitor_request_t request)
+{
+    m_monitor_requests.fetch_add(1, std::memory_order_relaxed);
+
+    if (m_monitor_request.exchange(request) == monitor_request_t::NONE)
+        m_hold_io.post([this]() { apply_monitor_request(); });
+    else
+        m_monitor_superseded.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+    m_hold_thread, runs the latest monitor request. AudioMonitor is thread safe, m_mutex is not taken so talk
+        events and status changes are not held behind the volume pass.
+*/
+void VolumeOptions::apply_monitor_request()
+{
+    const monitor_request_t request = m_monitor_request.exchange(monitor_request_t::NONE);
+
+    switch (request)
     {
+    case monitor_request_t::START:
         // if someone non disabled talked while audio monitor was down, start it
-        if (!m_someone_enabled_is_talking)
+        if (m_paudio_monitor->GetStatus() != AudioMonitor::monitor_status_t::RUNNING) // so we dont repeat it.
         {
-            if (m_status == status::ENABLED)
-            {
-                if (m_paudio_monitor->GetStatus() != AudioMonitor::monitor_status_t::RUNNING) // so we dont repeat it.
-                {
-                    dprintf("VO_PLUGIN: Audio Monitor Active. starting/resuming audio sessions volume monitor...\n");
-                    r = m_paudio_monitor->Start();
-                }
-            }
-            m_someone_enabled_is_talking = true;
+            dprintf("VO_PLUGIN: Audio Monitor Active. starting/resuming audio sessions volume monitor...\n");
+            m_paudio_monitor->Start();
         }
+        break;
+    case monitor_request_t::PAUSE:
+        if (m_paudio_monitor->GetStatus() != AudioMonitor::monitor_status_t::PAUSED) // so we dont repeat it.
+        {
+            dprintf("VO_PLUGIN: Audio Monitor Paused, restoring Sessions to user default volume...\n");
+            m_paudio_monitor->Pause();
+            //m_paudio_monitor->Stop();
+        }
+        break;
+    case monitor_request_t::STOP:
+        m_paudio_monitor->Stop();
+        break;
+    default:
+        break;
     }
-    return r;
+}
+
+/*
+    Waits for the next m_talk_hold deadline, if any. Call it with m_mutex held.
+*/
+void VolumeOptions::arm_hold_timer()
+{
+    const std::chrono::steady_clock::time_point deadline = m_talk_hold.next_deadline();
+    if (deadline == std::chrono::steady_clock::time_point::max())
+    {
+        m_hold_timer.cancel();
+        return;
+    }
+
+    // replaces any pending wait, its handler gets operation_aborted.
+    m_hold_timer.expires_at(deadline);
+    m_hold_timer.async_wait(std::bind(&VolumeOptions::on_hold_timer, this, std::placeholders::_1));
+}
+
+/*
+    m_hold_thread, a delayed duck or release is due.
+*/
+void VolumeOptions::on_hold_timer(const boost::system::error_code& ec)
+{
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    // m_talk_hold checks the deadline itself, a handler queued just before a re-arm does nothing.
+    if (m_status == status::ENABLED)
+        run_talk_action(m_talk_hold.poll(std::chrono::steady_clock::now()));
+    arm_hold_timer();
 }
 
 /*
@@ -833,132 +1146,228 @@ int VolumeOptions::apply_status()
     uniqueClientID  ->  TS3 client unique ID
     ownclient       ->  optional TODO: remove it and add own client to ignored list.
 
-    We use two sets:
+    Called on the TS3 client event thread, it must never wait on AudioMonitor (a Start or Pause rewrites every
+        session volume). The event is queued and m_hold_thread applies it, see push_talk.
+*/
+int VolumeOptions::process_talk(const bool talk_status, const uniqueServerID_t& uniqueServerID,
+    const channelID_t channelID, const uniqueClientID_t& uniqueClientID, const bool ownclient)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    push_talk(talk_status, uniqueServerID, channelID, uniqueClientID, ownclient);
+
+    m_talk_dwell.record(std::chrono::steady_clock::now() - start);
+    return 1; // TODO error codes
+}
+
+/*
+    Batched process_talk, for bursts (joining a busy channel, switching servers, a whole squad keying up).
+
+    Events are queued in order like process_talk does, a drain applies the ones it finds with m_mutex taken
+        once and runs apply_status after the last one.
+    A client starting and stopping inside the same drain never reaches AudioMonitor (or m_talk_hold),
+        only the transition between the state before and after it does.
+*/
+int VolumeOptions::process_talk_batch(const talk_event* events, const size_t count)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        const talk_event& e = events[i];
+        push_talk(e.talk_status, e.uniqueServerID, e.channelID, e.uniqueClientID, e.ownclient);
+    }
+
+    m_talk_dwell.record(std::chrono::steady_clock::now() - start);
+    return 1;
+}
+
+/*
+    Queues a talk event for m_hold_thread, any thread, never waits on AudioMonitor.
+
+    Same hand off as AudioMonitor::PushCommand: the event is copied into a lock free ring and only the first
+        event after a drain started posts drain_talk_events, the rest of a burst rides along with it.
+    Unique ids are copied inline into the ring cell (queued_talk), a push does not allocate, m_hold_thread
+        resolves them to keys.
+    If the ring is full m_hold_thread is far behind, the caller applies the queued events and its own one
+        itself, ids longer than a cell holds take the same path. m_mutex is never held across AudioMonitor
+        calls, so that waits for a drain at most.
+*/
+void VolumeOptions::push_talk(const bool talk_status, const uniqueServerID_t& uniqueServerID,
+    const channelID_t channelID, const uniqueClientID_t& uniqueClientID, const bool ownclient)
+{
+    m_talk_events_pushed.fetch_add(1, std::memory_order_relaxed);
+
+    if ((uniqueServerID.size() <= queued_talk::max_id) && (uniqueClientID.size() <= queued_talk::max_id))
+    {
+        queued_talk q;
+        q.talk_status = talk_status;
+        q.ownclient = ownclient;
+        q.server_size = static_cast<uint8_t>(uniqueServerID.size());
+        q.client_size = static_cast<uint8_t>(uniqueClientID.size());
+        q.channelID = channelID;
+        uniqueServerID.copy(q.server, q.server_size);
+        uniqueClientID.copy(q.client, q.client_size);
+
+        if (m_talk_events.try_push(std::move(q)))
+        {
+            if (!m_talk_drain_pending.exchange(true))
+                m_hold_io.post([this]() { drain_talk_events(); });
+            return;
+        }
+    }
+
+    m_talk_overflows.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    // queued events first, they happened before this one.
+    pop_talk_events();
+    record_talk(talk_status, uniqueServerID, channelID, uniqueClientID, ownclient);
+    apply_status();
+}
+
+/*
+    m_hold_thread, applies every queued talk event and evaluates the talk status once.
+*/
+void VolumeOptions::drain_talk_events()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    // events pushed from now on post another drain, even if this one ends up applying them.
+    m_talk_drain_pending.store(false);
+
+    if (pop_talk_events())
+    {
+        m_talk_drains.fetch_add(1, std::memory_order_relaxed);
+        apply_status();
+    }
+}
+
+/*
+    Records the queued talk events, call it with m_mutex held (the ring consumer) and apply_status afterwards.
+*/
+size_t VolumeOptions::pop_talk_events()
+{
+    size_t n = 0;
+    queued_talk q;
+    while (m_talk_events.try_pop(q))
+    {
+        // assign reuses the buffers, once they grew to an id size interning known keys allocates nothing.
+        m_queued_server.assign(q.server, q.server_size);
+        m_queued_client.assign(q.client, q.client_size);
+        record_talk(q.talk_status, m_queued_server, q.channelID, m_queued_client, q.ownclient);
+        n++;
+    }
+    return n;
+}
+
+/*
+    Waits until talk events queued before the call and the monitor requests they caused have run.
+    Delayed hysteresis transitions are not waited for. Not from m_hold_thread.
+*/
+void VolumeOptions::flush_talk_events()
+{
+    std::promise<void> done;
+    std::future<void> f = done.get_future();
+
+    // a drain queued before us may queue a monitor request, go to the back of the line once more.
+    m_hold_io.post([this, &done]() { m_hold_io.post([&done]() { done.set_value(); }); });
+    f.wait();
+}
+
+/*
+    Talk events counters and time callers spent in process_talk and process_talk_batch.
+*/
+VolumeOptions::talk_ingest_stats VolumeOptions::get_talk_ingest_stats() const
+{
+    talk_ingest_stats stats;
+    stats.calls = m_talk_dwell.calls();
+    stats.events = m_talk_events_pushed.load(std::memory_order_relaxed);
+    stats.overflows = m_talk_overflows.load(std::memory_order_relaxed);
+    stats.drains = m_talk_drains.load(std::memory_order_relaxed);
+    stats.monitor_requests = m_monitor_requests.load(std::memory_order_relaxed);
+    stats.monitor_superseded = m_monitor_superseded.load(std::memory_order_relaxed);
+    stats.dwell_total_ns = m_talk_dwell.total_ns();
+    stats.dwell_max_ns = m_talk_dwell.max_ns();
+    return stats;
+}
+
+/*
+    Updates talk state with one event, call it with m_mutex held and apply_status afterwards.
+
+    We use:
     m_ignored_clients and m_ignored_channels -> stores marked clients and channels.
-    m_clients_talking and m_channels_with_activity -> stores clientes and channels with someone currently talking.
+    m_talkers -> stores clients currently talking and the channel each one talks from.
+    m_channels_with_activity -> talkers and enabled talkers per channel with someone currently talking.
+    m_enabled_channels -> non disabled channels with enabled talkers, the only thing apply_status reads.
 
     To make it easy and not deal with TS3 callbacks we simply track clients talking and store them, and when they
         stop talking we delete them.
     NOTE: When clients stops talking because they are moved or etc, ts3 onTalkStatusChange can contain the destination
         channel, not the origin, we correct that case here.
 */
-int VolumeOptions::process_talk(const bool talk_status, const uniqueServerID_t uniqueServerID,
-    const channelID_t channelID, const uniqueClientID_t uniqueClientID, const bool ownclient)
+void VolumeOptions::record_talk(const bool talk_status, const uniqueServerID_t& uniqueServerID,
+    const channelID_t channelID, const uniqueClientID_t& uniqueClientID, const bool ownclient)
 {
-    int r = 1;
+    // We mark channelIDs as unique combining its virtual server key.
+    // Keys are interned, once server and client were seen this is two lookups and no allocation.
+    const channel_key uniqueChannel(m_server_keys.intern(uniqueServerID), channelID);
+    const talk_key_t client = m_client_keys.intern(uniqueClientID);
+#ifdef _DEBUG
+    uniqueChannelID_t uniqueChannelID(get_unique_channelid(uniqueServerID, channelID));
+#endif
 
-    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+    const bool enabled_client = !m_ignored_clients.count(client);
+    auto talker = m_talkers.find(client);
 
-    // We mark channelIDs as unique combining its virtual server ID.
-    uniqueChannelID_t uniqueChannelID(get_unique_channelid(uniqueServerID, channelID)); // Profiler only hot zone 6%
-    
     // if this is mighty ourselfs talking, ignore after we stop talking to update.
     // TODO if user ignores himself well get incorrect count, fix it. revise this.
-    if ((ownclient) && (m_vo_settings.exclude_own_client) && !m_clients_talking[ENABLED].count(uniqueClientID))
+    if ((ownclient) && (m_vo_settings.exclude_own_client) && !(enabled_client && (talker != m_talkers.end())))
     {
         dprintf("VO_PLUGIN: We are talking.. do nothing\n");
-        return r;
+        return;
     }
 
     // NOTE: We assume TS3 will always send talk_status false when other clients disconnects, changes channel or etc.
     if (talk_status)
     {
-        // Update client containers
-        if (m_ignored_clients.count(uniqueClientID))
-            m_clients_talking[DISABLED].insert(uniqueClientID);
-        else
-            m_clients_talking[ENABLED].insert(uniqueClientID);
-
-        // Update channel containers
-        if (m_ignored_channels.count(uniqueChannelID))
-            m_channels_with_activity[DISABLED][uniqueChannelID].insert(uniqueClientID);
-        else
-            m_channels_with_activity[ENABLED][uniqueChannelID].insert(uniqueClientID);
-
-#ifdef _DEBUG
-        // Care with this debug comments not to create a key, use .at()
-        size_t enabled_size = 0, disabled_size = 0;
-        try { enabled_size = m_channels_with_activity.at(ENABLED).at(uniqueChannelID).size(); }
-        catch (std::out_of_range) {}
-        try { disabled_size = m_channels_with_activity.at(DISABLED).at(uniqueChannelID).size(); }
-        catch (std::out_of_range) {}
-        dprintf("VO_PLUGIN: Update: m_channels_with_activity[DISABLED][%s].size()= %llu\n",
-            uniqueChannelID.c_str(), enabled_size);
-        dprintf("VO_PLUGIN: Update: m_channels_with_activity[ENABLED][%s].size()= %llu\n",
-            uniqueChannelID.c_str(), disabled_size);
-#endif
-
+        // A client talks from one channel at a time, a start from another one is a move.
+        if (talker == m_talkers.end())
+        {
+            m_talkers.emplace(client, uniqueChannel);
+            add_channel_talker(uniqueChannel, enabled_client);
+        }
+        else if (talker->second != uniqueChannel)
+        {
+            remove_channel_talker(talker->second, enabled_client);
+            talker->second = uniqueChannel;
+            add_channel_talker(uniqueChannel, enabled_client);
+        }
     }
     else
     {
+        // Substract client from the channel it talked from, if empty delete it.
         // Delete them directly, we dont know here if cause of stop was disconnection, channel change etc
-        if (m_ignored_clients.count(uniqueClientID))
-            m_clients_talking[DISABLED].erase(uniqueClientID);
-        else
-            m_clients_talking[ENABLED].erase(uniqueClientID);
-
-
-        // Substract client from channel count, if empty delete it.
         // TS3FIXNOTE: When a client is moved from a channel the talk status false has the new channel, not the old..
         // SELFNOTE: (i dont want to use ts3 callbacks for every case, a pain to mantain, concentrate all cases here)
-        uniqueChannelID_t channelID_origin = uniqueChannelID;
-        status channelID_origin_status;
-        for (int istatus = 0; istatus < m_channels_with_activity.size(); istatus++)
-        {   // 0 = status::DISABLED 1 = status::ENABLED
-            channelID_origin_status = static_cast<status>(istatus);
-            // low overhead, usualy a client is in as many channels as servers.
-            for (auto it_cinfo : m_channels_with_activity[istatus])
-            {
-                if (it_cinfo.second.count(uniqueClientID))
-                { 
-                    channelID_origin = it_cinfo.first; 
-                    goto done; // break nested with goto
-                }
-            }
+        if (talker != m_talkers.end())
+        {
+            remove_channel_talker(talker->second, enabled_client);
+            m_talkers.erase(talker);
         }
-        done:
-        // Now we got the real channel from where the client stopped talking, remove the client.
-        m_channels_with_activity[channelID_origin_status][channelID_origin].erase(uniqueClientID);
-        // if this was the last client from the channel talking delete the channel.
-        if (m_channels_with_activity[channelID_origin_status][channelID_origin].empty())
-            m_channels_with_activity[channelID_origin_status].erase(channelID_origin);
-
-#ifdef _DEBUG
-        // Care with this debug comments not to create a key, use .at()
-        size_t enabled_size = 0, disabled_size = 0;
-        try { enabled_size = m_channels_with_activity.at(ENABLED).at(uniqueChannelID).size(); }
-        catch (std::out_of_range) {}
-        try { disabled_size = m_channels_with_activity.at(DISABLED).at(uniqueChannelID).size(); }
-        catch (std::out_of_range) {}
-        dprintf("VO_PLUGIN: Update: m_channels_with_activity[ENABLED][%s].size()= %llu\n", uniqueChannelID.c_str(), enabled_size);
-        dprintf("VO_PLUGIN: Update: m_channels_with_activity[DISABLED][%s].size()= %llu\n", uniqueChannelID.c_str(), disabled_size);
-#endif
-
     }
 
 #ifdef _DEBUG
-    // Care with this debug comments not to create a key, use .at()
-    size_t enabled_size = 0, disabled_size = 0;
-    try { enabled_size = m_clients_talking.at(ENABLED).size();}
-    catch (std::out_of_range) {}
-    try { disabled_size = m_clients_talking.at(DISABLED).size();}
-    catch (std::out_of_range) {}
-    dprintf("VO_PLUGIN: Total Users currently talking (enabled): %llu\n", enabled_size);
-    dprintf("VO_PLUGIN: Total Users currently talking (disabled): %llu\n\n", disabled_size);
-
-    enabled_size = 0; disabled_size = 0;
-    try { enabled_size = m_channels_with_activity.at(ENABLED).size();}
-    catch (std::out_of_range) {}
-    try { disabled_size = m_channels_with_activity.at(DISABLED).size();}
-    catch (std::out_of_range) {}
-    dprintf("VO_PLUGIN: Total Channels with activity (enabled): %llu\n", enabled_size);
-    dprintf("VO_PLUGIN: Total Channels with activity (disabled): %llu\n\n", disabled_size);
+    // Care with this debug comments not to create a key, use find()
+    auto activity = m_channels_with_activity.find(uniqueChannel);
+    if (activity != m_channels_with_activity.end())
+        dprintf("VO_PLUGIN: Update: m_channels_with_activity[%s] talkers= %u enabled= %u\n", uniqueChannelID.c_str(),
+            activity->second.talkers, activity->second.enabled_talkers);
+    dprintf("VO_PLUGIN: Total Users currently talking: %llu\n", (unsigned long long)m_talkers.size());
+    dprintf("VO_PLUGIN: Total Channels with activity: %llu (enabled talking: %llu)\n\n",
+        (unsigned long long)m_channels_with_activity.size(), (unsigned long long)m_enabled_channels);
 #endif
-
-    // Update audio monitor status
-    apply_status();
-
-    return r; // TODO error codes
 }
 
 } // end namespace vo
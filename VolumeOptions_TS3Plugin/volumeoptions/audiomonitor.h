@@ -0,0 +1,658 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Portable AudioMonitor core.
+
+    The ducking engine (saved sessions, restores, expiration, exclusion) is written once here and
+        parametrized on a session Backend policy that talks to the OS, see audiomonitor_wasapi.h for
+        the SndVol (WASAPI) backend and audiomonitor_sim.h for the in memory one.
+
+    All backend calls are static and resolved at compile time, the backend TU explicitly instantiates
+        the templates from audiomonitor_impl.hpp so hot paths inline with no virtual dispatch.
+*/
+
+#ifndef VO_AUDIOMONITOR_H
+#define VO_AUDIOMONITOR_H
+
+#ifdef _WIN32
+#include <WinSDKVer.h>
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0601 // Minimum Win7 or Windows Server 2008 R2
+#endif
+#endif
+
+#include <boost/asio.hpp> // include Asio before including windows headers
+#include <boost/asio/steady_timer.hpp>
+
+#ifdef _WIN32
+#include <SDKDDKVer.h>
+#include <windows.h>
+#else
+// Win32 types and result codes used by the core, so it reads the same on every platform.
+#include <cstdint>
+typedef int32_t HRESULT; // 32 bits like the Win32 LONG, a 64 bit long would make every error code positive
+typedef unsigned long DWORD;
+#define S_OK            ((HRESULT)0L)
+#define S_FALSE         ((HRESULT)1L)
+#define E_FAIL          ((HRESULT)0x80004005L)
+#define E_POINTER       ((HRESULT)0x80004003L)
+#define E_INVALIDARG    ((HRESULT)0x80070057L)
+#define E_NOTFOUND      ((HRESULT)0x80070490L)
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+#endif
+
+#include <functional>
+#include <unordered_map>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <utility>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cassert>
+
+#include "../volumeoptions/config.h"
+#include "../volumeoptions/vo_settings.h"
+#include "../volumeoptions/string_pool.h"
+#include "../volumeoptions/process_filter.h"
+#include "../volumeoptions/session_profiles.h"
+#include "../volumeoptions/session_table.h"
+#include "../volumeoptions/timer_wheel.h"
+#include "../volumeoptions/mpsc_ring.h"
+#include "../volumeoptions/monitor_reactor.h"
+#include "../volumeoptions/volume_journal.h"
+
+#ifndef CHECK_HR
+#define CHECK_HR(hr) if (FAILED(hr)) { assert(false); goto done; }
+#endif
+
+namespace vo {
+
+/*
+    Backend independent session state, same values as WASAPI AudioSessionState.
+*/
+enum class session_state_t { INACTIVE = 0, ACTIVE = 1, EXPIRED = 2 };
+
+/*
+    Backend callbacks handed over to the monitor thread, see BasicAudioMonitor::PushCommand.
+*/
+enum class command_t { SESSION_CREATED, STATE_CHANGED, VOLUME_CHANGED };
+
+/*
+    Rendering endpoint changes reported by the backend, see Backend::watch_endpoints.
+    Listeners are called on backend threads, they must not block.
+*/
+enum class endpoint_event_t { ADDED, REMOVED, DEFAULT_CHANGED };
+typedef std::function<void(endpoint_event_t, const std::wstring& device_id)> endpoint_listener;
+
+/*
+    Constant data of a session as reported by the backend before we save it.
+*/
+struct session_info
+{
+    session_info()
+        : pid(0)
+        , system_sounds(false)
+    {}
+
+    DWORD pid;
+    std::wstring sid;   // SessionIdentifier, NOT unique (same for every instance of a process)
+    std::wstring siid;  // SessionInstanceIdentifier, unique
+    bool system_sounds;
+};
+
+/*
+    Backend policy requirements (all static):
+
+    Types:
+        session_source      raw session as delivered by enumeration or new session notifications.
+        session_handle      per session OS state, owned by BasicAudioSession.
+        manager_handle      per endpoint OS state, owned by BasicAudioMonitor.
+        callback_proxy      class allowed to reach private methods from backend callbacks.
+        endpoint_watch      endpoint notifications registration (default constructible).
+        default_endpoint_state_mask
+
+    Endpoint:   thread_init, current_process_id, get_endpoints_info, open_manager, close_manager,
+                manager_ready, register_notifications, unregister_notifications, enumerate_sessions,
+                watch_endpoints(endpoint_watch, endpoint_listener), unwatch_endpoints
+    Session:    get_session_info, get_session_instance_id (SIID only, cheaper), release_source,
+                open_session, close_session, is_open,
+                register_session_events, unregister_session_events, get_state, get_volume, set_volume,
+                settle_new_session
+    Commands:   run_command(manager_handle, command_t, f), calls f() on the monitor thread to handle one
+                command pushed by the backend callbacks (a place to instrument them).
+*/
+
+namespace detail {
+
+/*
+    Round trip times of synchronous calls (post, run on the io_service thread, wake up the caller).
+*/
+class sync_call_latency
+{
+public:
+    sync_call_latency() : m_calls(0), m_total_ns(0), m_max_ns(0) {}
+
+    void record(std::chrono::steady_clock::duration d)
+    {
+        const uint64_t ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+        m_calls.fetch_add(1, std::memory_order_relaxed);
+        m_total_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t max = m_max_ns.load(std::memory_order_relaxed);
+        while ((ns > max) && !m_max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+    }
+
+    uint64_t calls() const { return m_calls.load(std::memory_order_relaxed); }
+    uint64_t total_ns() const { return m_total_ns.load(std::memory_order_relaxed); }
+    uint64_t max_ns() const { return m_max_ns.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> m_calls;
+    std::atomic<uint64_t> m_total_ns;
+    std::atomic<uint64_t> m_max_ns;
+};
+
+} // end namespace detail
+
+template <class Backend> class BasicAudioMonitor;
+
+/*
+    Represents a single Audio Session to be managed by AudioMonitor
+*/
+template <class Backend>
+class BasicAudioSession : public std::enable_shared_from_this < BasicAudioSession<Backend> >
+{
+public:
+    typedef BasicAudioMonitor<Backend> monitor_type;
+
+    BasicAudioSession(const BasicAudioSession &) = delete; // non copyable
+    BasicAudioSession& operator= (const BasicAudioSession&) = delete; // non copyassignable
+    ~BasicAudioSession();
+
+    /* public methods here must be const, thread safe and non bloking */
+    /* this class will be called from external callbacks sometimes through shared_ptr */
+    /* and require non bloking actions, so.. no mutex alowed inside public methods */
+    HRESULT GetStatus() const { return m_hrStatus; };
+
+    const std::wstring& getSID() const;
+    const std::wstring& getSIID() const;
+    const interned_wstring& getInternedSID() const { return m_sid; }
+    const interned_wstring& getInternedSIID() const { return m_siid; }
+    DWORD getPID() const;
+
+private:
+    BasicAudioSession(typename Backend::session_source pSessionControl, const session_info& info,
+        const interned_wstring& sid, const interned_wstring& siid,
+        const std::weak_ptr<monitor_type>& spAudioMonitor, float default_volume_fix = -1.0f);
+
+    void ShutdownSession();
+
+    void InitEvents();
+    void StopEvents();
+
+    void state_changed_callback_handler(session_state_t newstatus);
+
+    HRESULT ApplyVolumeSettings(); // TODO: or make it public with async and bool restore_vol optional merging restorevolume
+    float ReducedVolume(const session_settings& ses_setting) const; // ducked volume for these settings
+
+    float GetCurrentVolume() const;
+    void UpdateDefaultVolume(const float new_def);
+
+    // NO_DELAY skips vol_up_delay, NO_RAMP also skips the release ramp.
+    enum class resume_t { NORMAL, NO_DELAY, NO_RAMP };
+    void RestoreVolume(resume_t callback_type = resume_t::NORMAL);
+
+    void ChangeVolume(const float v);
+
+    enum class ramp_t { ATTACK, RELEASE };
+    void RampVolume(const float target, const ramp_t ramp);
+    float RampValue(const std::chrono::steady_clock::time_point now) const;
+
+    void touch(); // marks the session as the last modified of its SID group.
+    void JournalState(); // records default volume and duck state changes, see volume_journal
+    void set_state(session_state_t state);
+
+    session_state_t m_current_state; // auto updated with session events.
+
+    float m_default_volume; // always marks user default volume of this SID group session
+    bool m_is_volume_at_default;  // if true, session volume is at user default volume
+    float m_volume; // last volume read or set by us
+
+    // Volume ramp in flight, advanced by the monitor ramp tick.
+    float m_ramp_from;
+    float m_ramp_to;
+    ramp_curve_t m_ramp_curve;
+    std::chrono::steady_clock::time_point m_ramp_start;
+    std::chrono::steady_clock::duration m_ramp_duration;
+    uint32_t m_ramp_index; // position in monitor m_ramps, or no_ramp
+
+    timer_handle m_restore_timer; // vol_up_delay restore pending on the monitor timer wheel
+
+    bool m_excluded_flag; // true if this session is temporarily exluded for volume change.
+    uint32_t m_excluded_generation; // monitor filter generation m_excluded_flag was computed with, 0 = never.
+    uint32_t m_profile; // monitor m_profiles index, profile_table::no_profile = global session settings.
+    uint32_t m_volume_command; // index of this session's command in the monitor volume batch, or no_volume_command.
+    bool m_session_dead; // only true when all internal backend references all released with ShutdownSession().
+
+    DWORD m_pid;
+    interned_wstring m_sid; // keeps the ids of m_slot alive
+    interned_wstring m_siid;
+
+    mutable std::atomic<HRESULT> m_hrStatus;
+
+    // Latest external volume change, written by callback threads, see BasicAudioMonitor::PushVolumeChange.
+    std::atomic<float> m_external_volume;
+    std::atomic<bool> m_external_volume_dirty; // a VOLUME_CHANGED command is queued and will read it
+
+    std::chrono::steady_clock::time_point m_last_active_state;
+
+    slot_handle m_slot; // position in AudioMonitor saved sessions
+    uint32_t m_refresh_epoch; // last AudioMonitor RefreshSessions pass that listed this session
+
+    typename Backend::session_handle m_handle; // OS side of the session (interfaces, events, etc)
+
+    std::weak_ptr<monitor_type> m_wpAudioMonitor;  // To witch monitor it blongs
+
+    std::shared_ptr<volume_journal> m_journal; // monitor journal when saved, kept for the restore on destruction
+    float m_journal_volume; // as last recorded, -1 = never
+    bool m_journal_ducked;
+
+    /* Only this class can manage this object in thread safe way */
+    friend class BasicAudioMonitor<Backend>;
+    friend typename Backend::callback_proxy;
+};
+
+
+/*
+    Monitor manager main class, Monitors current audio sessions to change volume on,
+        based on customizable settings.
+
+    Manages a single audio device per instance.
+
+    Use ::create() to instance the class, it will return a std::shared_ptr.
+    create(device_id) runs the monitor on its own thread, create(reactor, device_id) on a shared
+        monitor_reactor (see CreateReactor), handlers of each monitor are serialized on its own strand.
+
+*/
+template <class Backend>
+class BasicAudioMonitor : public std::enable_shared_from_this < BasicAudioMonitor<Backend> >
+{
+public:
+    typedef Backend backend_type;
+    typedef BasicAudioSession<Backend> session_type;
+
+    /* Created with STOPPED status */
+    template<typename ...T>
+    static std::shared_ptr<BasicAudioMonitor> create(T&&... all)
+    {
+        return std::shared_ptr<BasicAudioMonitor>(new BasicAudioMonitor(std::forward<T>(all)...));
+    }
+    BasicAudioMonitor(const BasicAudioMonitor &) = delete; // non copyable
+    BasicAudioMonitor& operator= (const BasicAudioMonitor&) = delete; // non copyassignable
+    ~BasicAudioMonitor(); // never release the last reference from a monitor handler
+
+    // reactor for create(reactor, ...), its threads are initialized for the backend.
+    static std::shared_ptr<monitor_reactor> CreateReactor(unsigned threads);
+
+    // audio_endpoints: returns a DeviceID -> DeviceName map with current audio rendering devices
+    static HRESULT GetEndpointsInfo(std::map<std::wstring, std::wstring>& audio_endpoints,
+        DWORD dwStateMask = Backend::default_endpoint_state_mask);
+    static std::set<std::wstring> GetCurrentMonitoredEndpoints();
+
+    // Moves to another endpoint without a Stop, L"" follows the default endpoint (see MigrateEndpoint).
+    long ChangeDeviceID(const std::wstring& device_id);
+    bool FollowsDefaultEndpoint() const { return m_follow_default; } // thread safe, non blocking
+
+    float GetVolumeReductionLevel(); // thread safe, non blocking
+
+    // Crash safe default volumes, set it before Start, only sessions saved from then on use it.
+    long SetJournal(const std::shared_ptr<volume_journal>& journal);
+
+    struct volume_write_stats
+    {
+        uint64_t writes;    // OS volume writes
+        uint64_t throttled; // ramp steps postponed by monitor_settings::max_volume_writes
+    };
+    volume_write_stats GetVolumeWriteStats() const; // thread safe, non blocking
+
+    struct command_stats
+    {
+        uint64_t commands;  // backend callbacks handed to the monitor thread
+        uint64_t batches;   // command ring drains that ran at least one
+        uint64_t overflows; // commands queued in the overflow list because the ring was full
+        uint64_t volume_changes;   // external volume change callbacks
+        uint64_t volume_coalesced; // volume changes folded into one already queued for the session
+        uint64_t volume_applied;   // volume changes that reached the session (changes - coalesced)
+    };
+    command_stats GetCommandStats() const; // thread safe, non blocking
+
+    struct sync_call_stats
+    {
+        uint64_t calls;    // public calls marshalled to the monitor thread
+        uint64_t total_ns; // summed round trip, caller side
+        uint64_t max_ns;
+    };
+    sync_call_stats GetSyncCallStats() const; // thread safe, non blocking
+
+    struct migration_stats
+    {
+        uint64_t migrations;    // endpoint changes done without a Stop
+        uint64_t ducks_carried; // new endpoint sessions that took the duck state of their app on the old one
+        uint64_t retired;       // retired sessions torn down, old endpoint ones and vanished ones (Refresh)
+    };
+    migration_stats GetMigrationStats() const; // thread safe, non blocking
+
+    struct refresh_stats
+    {
+        uint64_t refreshes; // RefreshSessions passes
+        uint64_t listed;    // enumerated sessions already saved, only their SIID was read
+        uint64_t added;     // enumerated sessions saved by a refresh
+        uint64_t vanished;  // saved sessions no longer enumerated, retired
+    };
+    refresh_stats GetRefreshStats() const; // thread safe, non blocking
+
+    typedef std::shared_ptr<const vo::monitor_settings> settings_snapshot;
+    void SetSettings(vo::monitor_settings& settings);
+    vo::monitor_settings GetSettings(); // a copy of GetSettingsSnapshot()
+    settings_snapshot GetSettingsSnapshot() const; // thread safe, non blocking, never modified once published
+
+    /* If Resume is used while Stopped it will use Start() */
+    long Stop(); // Stops all events and deletes all saved sessions restoring default state.
+    long Pause(); // Restores volume on all sessions and locks volume change.
+    long Start(); // Resumes/Starts volume change and reapplies saved settings.
+    long Refresh(); // Saves sessions missed by notifications and retires vanished ones, see RefreshSessions.
+
+    enum class monitor_status_t { STOPPED, RUNNING, PAUSED, INITERROR };
+    enum class monitor_error_t { OK, DEVICE_NOT_FOUND, DEVICEID_IN_USE, IOTHREAD_START_ERROR }; // TODO boost errors
+    monitor_status_t GetStatus(); // thread safe, non blocking
+    monitor_error_t GetErrorStatus() const { return m_error_status; } // set on creation only
+    std::wstring GetDeviceID() const; // thread safe, changes with ChangeDeviceID and default endpoint changes
+
+    std::shared_ptr<boost::asio::io_service> get_io() const;
+
+private:
+
+    BasicAudioMonitor(const std::wstring& device_id = L"");
+    BasicAudioMonitor(const std::shared_ptr<monitor_reactor>& reactor, const std::wstring& device_id = L"");
+    void StartIOInit();
+    void FinishIOInit();
+    void ShutdownIO();
+    template <class F> void Post(F f); // runs f on m_strand
+
+#ifdef VO_ENABLE_EVENTS
+    long InitEvents();
+    long StopEvents();
+#endif
+
+    void PublishSettings();
+    bool EnterMonitor(std::unique_lock<std::recursive_mutex>& l); // false if the call must be marshalled
+
+    HRESULT RefreshSessions();
+    void RetireSession(slot_handle h);
+    void DeleteSessions();
+
+    HRESULT SaveSession(typename Backend::session_source pNewSessionControl, const bool unref);
+    void DeleteSession(std::shared_ptr<session_type> spAudioSession); // Not used
+    void DeleteExpiredSessions();
+    void ExpireSessions(const std::chrono::steady_clock::time_point now);
+    void UpdateExpiry(session_type* session);
+    void ArmExpireTimer();
+    void ApplyMonitorSettings();
+
+    // Volume writes of one monitor tick, see volume_batch_scope.
+    enum : uint32_t { no_volume_command = 0xFFFFFFFF };
+    struct volume_command
+    {
+        session_type* session; // null if the session already wrote it
+        float volume;
+    };
+    bool QueueVolume(session_type* session, const float volume);
+    void FlushVolume(session_type* session);
+    void SubmitVolumeBatch();
+    HRESULT WriteVolume(session_type* session, const float volume);
+
+    // Volume ramps, see RampTick.
+    enum : uint32_t { no_ramp = 0xFFFFFFFF };
+    void AddRamp(session_type* session);
+    void CancelRamp(session_type* session);
+    void ArmRampTimer();
+    void RampTick();
+
+    void CompactJournal(); // on a reactor thread, off the strand
+
+    // Monitor timers, all of them multiplexed on m_timers, see ArmWheelTimer.
+    enum class timer_kind_t { RESTORE, EXPIRE, RAMP, RETIRE };
+    struct monitor_timer
+    {
+        timer_kind_t kind;
+        session_type* session; // RESTORE only, the session cancels it before going away
+    };
+    void ScheduleTimer(timer_handle& h, const std::chrono::steady_clock::duration delay,
+        const timer_kind_t kind, session_type* session = nullptr);
+    void CancelTimer(timer_handle& h);
+    void ArmWheelTimer();
+    void WheelTick(boost::system::error_code const& e);
+    void OnTimer(const monitor_timer& t);
+
+    /*
+        While a scope is alive ChangeVolume only records the target volume, the last one per session wins,
+            all of them are written in one pass when the outermost scope ends.
+    */
+    class volume_batch_scope
+    {
+    public:
+        explicit volume_batch_scope(BasicAudioMonitor& m) : m_monitor(m) { m_monitor.m_volume_batch_depth++; }
+        ~volume_batch_scope()
+        {
+            if (--m_monitor.m_volume_batch_depth == 0)
+                m_monitor.SubmitVolumeBatch();
+        }
+    private:
+        volume_batch_scope(const volume_batch_scope&) = delete;
+        volume_batch_scope& operator=(const volume_batch_scope&) = delete;
+        BasicAudioMonitor& m_monitor;
+    };
+    bool isSessionExcluded(const DWORD pid, const interned_wstring& sid = interned_wstring());
+    uint32_t FindProfile(const interned_wstring& sid) const;
+    static void ClampSessionSettings(session_settings& ses_settings);
+    const session_settings& SessionSettings(const uint32_t profile) const; // a session settings, global or its own
+
+    // Backend callback handed to the monitor thread, a fixed size record.
+    struct monitor_command
+    {
+        monitor_command()
+            : kind(command_t::STATE_CHANGED)
+            , source()
+            , state(session_state_t::INACTIVE)
+        {}
+
+        static monitor_command session_created(typename Backend::session_source s)
+        {
+            monitor_command c;
+            c.kind = command_t::SESSION_CREATED;
+            c.source = s;
+            return c;
+        }
+        static monitor_command state_changed(std::shared_ptr<session_type> session, session_state_t state)
+        {
+            monitor_command c;
+            c.kind = command_t::STATE_CHANGED;
+            c.session = std::move(session);
+            c.state = state;
+            return c;
+        }
+        static monitor_command volume_changed(std::shared_ptr<session_type> session)
+        {
+            monitor_command c;
+            c.kind = command_t::VOLUME_CHANGED;
+            c.session = std::move(session);
+            return c;
+        }
+
+        command_t kind;
+        std::shared_ptr<session_type> session;      // STATE_CHANGED, VOLUME_CHANGED (value in the session)
+        typename Backend::session_source source;    // SESSION_CREATED, already referenced for us
+        session_state_t state;
+    };
+    enum { command_ring_size = 1024 };
+    void PushCommand(monitor_command&& c); // any thread, never blocks
+    void PushVolumeChange(std::shared_ptr<session_type> session, float volume); // any thread, never blocks
+    void DrainCommands();
+    void RunCommand(monitor_command& c);
+    void DiscardCommands();
+
+    void RemoveDeviceID(const std::wstring& device_id);
+    HRESULT InitDeviceID(const std::wstring& device_id);
+
+    // Endpoint changes, see MigrateEndpoint.
+    struct carried_duck
+    {
+        std::chrono::steady_clock::time_point restore_due; // pending delayed restore, max() if none
+    };
+    typedef std::map<std::wstring, carried_duck> carried_ducks; // by app key, see AppKey
+    static std::wstring AppKey(const std::wstring& sid);
+    void WatchEndpoints();
+    void OnEndpointEvent(endpoint_event_t e, const std::wstring& device_id);
+    HRESULT MigrateEndpoint(const std::wstring& device_id);
+    carried_ducks SnapshotDucks() const;
+    void CarryDuck(session_type* session);
+    void RetireSessions();
+    void RetireTick();
+    void DropRetiredSessions();
+
+    typename Backend::manager_handle m_manager; // OS side of the endpoint (session manager, notifications)
+    std::wstring m_wsDeviceID; // current audio endpoint ID beign monitored, written under m_static_set_access.
+    std::atomic<bool> m_follow_default; // created or changed with L"", default endpoint changes move the monitor
+    bool m_endpoint_lost; // our endpoint was removed, it is reopened if it comes back
+    typename Backend::endpoint_watch m_endpoint_watch; // from the first Start to ShutdownIO
+    static std::set<std::wstring> m_current_monitored_deviceids;
+    static std::mutex m_static_set_access;
+
+    // Settings
+    DWORD m_processid;
+    vo::monitor_settings m_settings;
+    settings_snapshot m_settings_snapshot; // m_settings as last published, std::atomic_load/atomic_store only
+    std::atomic<float> m_vol_reduction; // published m_settings.ses_global_settings.vol_reduction
+    process_filter m_filter; // m_settings pid and process filters, compiled
+    uint32_t m_filter_generation; // bumped each time m_filter changes, stamps session exclusion verdicts
+    profile_table m_profiles; // m_settings.ses_individual_settings, compiled
+    const std::chrono::seconds m_inactive_timeout;
+    // Main sessions container type
+
+    // Delayed restores, expiry checks and ramp ticks, driven by m_wheel_timer.
+    timer_wheel<monitor_timer> m_timers;
+    timer_handle m_expire_timer; // oldest inactive saved session timeout
+
+    bool m_auto_change_volume_flag; // SELFNOTE: we can delete this and use m_current_status, either way..
+    //monitor_status_t m_current_status;
+    std::atomic<monitor_status_t> m_current_status;
+    monitor_error_t m_error_status;
+
+    // Main sessions container type
+    typedef session_table<std::shared_ptr<session_type>> t_saved_sessions;
+    // Sessions currently Monitored,
+    //	slots keyed by interned SIID (SessionInstanceIdentifier), grouped by interned SID
+    // You could look at it as group of different SIID sessions with the same SID.
+    // note: remember to cancel its corresponding session m_restore_timer
+    t_saved_sessions m_saved_sessions;
+
+    // Sessions of the endpoint we left, torn down a few per RETIRE tick, see RetireSessions.
+    enum { retire_delay_ms = 1000, retire_batch = 16 };
+    std::vector<std::shared_ptr<session_type>> m_retired_sessions;
+    timer_handle m_retire_timer;
+    carried_ducks* m_carried_ducks; // duck state of the old endpoint apps while MigrateEndpoint saves new sessions
+    std::atomic<uint64_t> m_migrations;
+    std::atomic<uint64_t> m_ducks_carried;
+    std::atomic<uint64_t> m_sessions_retired;
+
+    uint32_t m_refresh_epoch; // current RefreshSessions pass, stamped on the sessions it lists
+    std::atomic<uint64_t> m_refreshes;
+    std::atomic<uint64_t> m_refresh_listed;
+    std::atomic<uint64_t> m_refresh_added;
+    std::atomic<uint64_t> m_refresh_vanished;
+
+    std::vector<volume_command> m_volume_batch; // pending volume writes of the current tick
+    unsigned m_volume_batch_depth; // open volume_batch_scope count
+
+    friend class BasicAudioSession<Backend>;
+    friend typename Backend::callback_proxy; /* To select wich private methods others classes can access */
+
+    /* To sync Events with main class without "blocking" (async)
+        or we cause mem leaks on simultaneous callbacks (confirmed) */
+    std::shared_ptr<monitor_reactor> m_reactor; // threads running our handlers, shared or private
+    std::shared_ptr<boost::asio::io_service> m_io; // m_reactor io_service
+    std::shared_ptr<volume_journal> m_journal; // null if not journaling
+    std::unique_ptr<boost::asio::io_service::strand> m_strand; // serializes every handler of this monitor
+    bool m_abort; // shutting down (set on m_strand), nothing is armed or run anymore
+    std::atomic<uint32_t> m_handlers_pending; // Post handlers and wheel timer waits not finished yet
+
+    // Backend callbacks waiting for the monitor thread, see PushCommand.
+    mpsc_ring<monitor_command> m_commands;
+    std::atomic<bool> m_drain_pending; // a DrainCommands is posted and has not started yet
+    std::atomic<bool> m_commands_overflowed; // m_overflow is not empty, callbacks append to it
+    std::mutex m_overflow_mutex;
+    std::vector<monitor_command> m_overflow; // commands that found the ring full, in callback order
+    std::atomic<uint64_t> m_commands_pushed;
+    std::atomic<uint64_t> m_command_batches;
+    std::atomic<uint64_t> m_command_overflows;
+    std::atomic<uint64_t> m_volume_changes;
+    std::atomic<uint64_t> m_volume_coalesced;
+
+    // The only asio timer of the monitor, armed for the next due slot of m_timers.
+    std::unique_ptr<boost::asio::steady_timer> m_wheel_timer; // declared after m_io, destroyed before it.
+    std::chrono::steady_clock::time_point m_wheel_armed_at; // max() if not armed
+
+    // Sessions with a volume ramp in flight, one timer advances all of them.
+    std::vector<session_type*> m_ramps;
+    std::vector<session_type*> m_ramps_done; // RampTick scratch
+    timer_handle m_ramp_timer;
+    size_t m_ramp_cursor; // first ramp served on next tick, rotates when writes are capped
+    std::atomic<uint64_t> m_volume_writes;
+    std::atomic<uint64_t> m_volume_writes_throttled;
+
+    // Public calls from other threads are marshalled to m_strand, each one waits on its own slot.
+    std::atomic<bool> m_io_active; // false before StartIOInit and after ShutdownIO, public methods run inline
+    detail::sync_call_latency m_sync_latency;
+
+
+    // used to lock access to the class by only his own thread
+    mutable std::recursive_mutex m_mutex;
+};
+
+} // end namespace vo
+
+#endif
@@ -39,31 +39,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #ifdef _WIN32
 
-#include <WinSDKVer.h>
-#ifndef _WIN32_WINNT
-#define _WIN32_WINNT 0x0601 // Minimum Win7 or Windows Server 2008 R2
-#endif
-
-#include <boost/asio.hpp> // include Asio before including windows headers
-#include <boost/asio/steady_timer.hpp>
+#include "../volumeoptions/audiomonitor.h" // include before windows audio headers (Asio)
+#include "../volumeoptions/endpoint_manager.h"
 
-#include <SDKDDKVer.h>
 #include <Audiopolicy.h>
 #include <Mmdeviceapi.h>
 
-#include <unordered_map>
-#include <set>
-#include <utility>
-#include <memory>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <atomic>
-#include <chrono>
-
-#include "../volumeoptions/config.h"
-#include "../volumeoptions/vo_settings.h"
-
 #ifndef SAFE_RELEASE
 #define SAFE_RELEASE(x)             \
     if(x != NULL)                   \
@@ -73,10 +54,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     }
 #endif
 
-#ifndef CHECK_HR
-#define CHECK_HR(hr) if (FAILED(hr)) { assert(false); goto done; }
-#endif
-
 #ifdef _DEBUG
 inline ULONG CHECK_REFS(IUnknown *p)
 {
@@ -90,209 +67,101 @@ inline ULONG CHECK_REFS(IUnknown *p)
 
 namespace vo {
 
-class AudioMonitor;
-/*
-    Represents a single WASAPI Audio Session to be managed by AudioMonitor
-
-    TODO: make it nested class of audiomonitor for now.
-*/
-class AudioSession : public std::enable_shared_from_this < AudioSession >
-{
-public:
-
-    AudioSession(const AudioSession &) = delete; // non copyable
-    AudioSession& operator= (const AudioSession&) = delete; // non copyassignable
-    ~AudioSession();
-
-    /* public methods here must be const, thread safe and non bloking */
-    /* this class will be called from external callbacks sometimes through shared_ptr */
-    /* and require non bloking actions, so.. no mutex alowed inside public methods */
-    HRESULT GetStatus() const { return m_hrStatus; };
-
-    std::wstring getSID() const;
-    std::wstring getSIID() const;
-    DWORD getPID() const;
-
-private:
-    AudioSession(IAudioSessionControl *pSessionControl,
-        const std::weak_ptr<AudioMonitor>& spAudioMonitor, float default_volume_fix = -1.0f);
-
-    void ShutdownSession();
-
-    void InitEvents();
-    void StopEvents();
-
-    void state_changed_callback_handler(AudioSessionState newstatus);
-
-    HRESULT ApplyVolumeSettings(); // TODO: or make it public with async and bool restore_vol optional merging restorevolume
-
-    float GetCurrentVolume() const;
-    void UpdateDefaultVolume(const float new_def);
-
-    enum class resume_t { NORMAL = false, NO_DELAY = true };
-    void RestoreVolume(resume_t callback_type = resume_t::NORMAL);
-    void RestoreHolderCallback(boost::system::error_code const& e = boost::system::error_code());
-
-    void ChangeVolume(const float v);
-
-    void touch(); // sets m_last_modified_on now().
-    void set_state(AudioSessionState state);
-
-    AudioSessionState m_current_state; // auto updated with session events.
-
-    float m_default_volume; // always marks user default volume of this SID group session
-    bool m_is_volume_at_default;  // if true, session volume is at user default volume
-
-    bool m_excluded_flag; // true if this session is temporarily exluded for volume change.
-    bool m_session_dead; // only true when all internal wasapi references all released with ShutdownSession().
-
-    DWORD m_pid;
-    std::wstring m_sid;
-    std::wstring m_siid;
-
-    mutable std::atomic<HRESULT> m_hrStatus;
-
-    std::chrono::steady_clock::time_point m_last_modified_on;
-    std::chrono::steady_clock::time_point m_last_active_state;
-
-    IAudioSessionControl* m_pSessionControl;
-    IAudioSessionEvents *m_pAudioEvents;
-    IAudioSessionControl2* m_pSessionControl2;
-    ISimpleAudioVolume* m_pSimpleAudioVolume;
-
-    std::weak_ptr<AudioMonitor> m_wpAudioMonitor;  // To witch monitor it blongs
-
-    /* Only this class can manage this object in thread safe way */
-    friend class AudioMonitor;
-    friend class AudioCallbackProxy;
-};
-
+class AudioCallbackProxy;
 
 /*
-    WASAPI Monitor manager main class, Monitors current audio sessions to change volume on,
-        based on customizable settings.
-    
-    Manages a single audio device per instance.
-
-    Use ::create() to instance the class, it will return a std::shared_ptr.
+    WASAPI session backend for BasicAudioMonitor.
 
+    Owns every COM interface the core needs, the core only sees the handles below.
+    Definitions live in audiomonitor_wasapi.cpp next to the explicit template instantiation.
 */
-class AudioMonitor : public std::enable_shared_from_this < AudioMonitor >
+struct WasapiSessionBackend
 {
-public:
+    typedef IAudioSessionControl* session_source;
 
-    /* Created with STOPPED status */
-    // static std::shared_ptr<AudioMonitor> create(vo::monitor_settings&& settings,
-        //const std::wstring& device_id = L"")  // if no variadic template support
-    template<typename ...T>
-    static std::shared_ptr<AudioMonitor> create(T&&... all)
+    struct session_handle
     {
-        return std::shared_ptr<AudioMonitor>(new AudioMonitor(std::forward<T>(all)...));
-    }
-    AudioMonitor(const AudioMonitor &) = delete; // non copyable
-    AudioMonitor& operator= (const AudioMonitor&) = delete; // non copyassignable
-    ~AudioMonitor();
-
-    // audio_endpoints: returns a DeviceID -> DeviceName map with current audio rendering devices
-    static HRESULT GetEndpointsInfo(std::map<std::wstring, std::wstring>& audio_endpoints,
-        DWORD dwStateMask = DEVICE_STATE_ACTIVE);
-    static std::set<std::wstring> GetCurrentMonitoredEndpoints();
-
-    void ChangeDeviceID(const std::wstring& device_id);
-
-    float GetVolumeReductionLevel();
-    void SetSettings(vo::monitor_settings& settings);
-    vo::monitor_settings GetSettings();
-
-    /* If Resume is used while Stopped it will use Start() */
-    long Stop(); // Stops all events and deletes all saved sessions restoring default state.
-    long Pause(); // Restores volume on all sessions and locks volume change.
-    long Start(); // Resumes/Starts volume change and reapplies saved settings.
-#ifdef _DEBUG
-    long Refresh(); // DEBUG Gets all current sessions in SndVol
-#endif
-
-    enum class monitor_status_t { STOPPED, RUNNING, PAUSED, INITERROR };
-    enum class monitor_error_t { OK, DEVICE_NOT_FOUND, DEVICEID_IN_USE, IOTHREAD_START_ERROR }; // TODO boost errors
-    monitor_status_t GetStatus();
-    
-    std::shared_ptr<boost::asio::io_service> get_io() const;
+        session_handle()
+            : pSessionControl(NULL)
+            , pAudioEvents(NULL)
+            , pSessionControl2(NULL)
+            , pSimpleAudioVolume(NULL)
+        {}
+
+        IAudioSessionControl* pSessionControl;
+        IAudioSessionEvents *pAudioEvents;
+        IAudioSessionControl2* pSessionControl2;
+        ISimpleAudioVolume* pSimpleAudioVolume;
+    };
+
+    struct manager_handle
+    {
+        manager_handle()
+            : pSessionManager2(NULL)
+            , pSessionEvents(NULL)
+        {}
 
-private:
+        IAudioSessionManager2* pSessionManager2;
+        IAudioSessionNotification* pSessionEvents;
+    };
 
-    AudioMonitor(const std::wstring& device_id = L"");
-    void StartIOInit();
-    void FinishIOInit();
+    struct endpoint_watch
+    {
+        endpoint_watch()
+            : pEnumerator(NULL)
+            , pClient(NULL)
+        {}
+
+        IMMDeviceEnumerator* pEnumerator;
+        IMMNotificationClient* pClient;
+    };
+
+    typedef AudioCallbackProxy callback_proxy;
+
+    static const DWORD default_endpoint_state_mask = DEVICE_STATE_ACTIVE;
+
+    typedef BasicAudioSession<WasapiSessionBackend> session_type;
+    typedef BasicAudioMonitor<WasapiSessionBackend> monitor_type;
+
+    // Endpoint
+    static void thread_init();
+    static DWORD current_process_id();
+    static HRESULT get_endpoints_info(std::map<std::wstring, std::wstring>& audio_endpoints, DWORD dwStateMask);
+    static HRESULT open_manager(manager_handle& m, std::wstring& device_id);
+    static void close_manager(manager_handle& m);
+    static bool manager_ready(const manager_handle& m);
+    static HRESULT register_notifications(manager_handle& m, const std::weak_ptr<monitor_type>& wpAudioMonitor);
+    static HRESULT unregister_notifications(manager_handle& m);
+    static HRESULT enumerate_sessions(manager_handle& m, const std::function<void(session_source)>& f);
+    static HRESULT watch_endpoints(endpoint_watch& w, const endpoint_listener& f);
+    static void unwatch_endpoints(endpoint_watch& w);
+
+    // Session
+    static HRESULT get_session_info(session_source s, session_info& info);
+    static HRESULT get_session_instance_id(session_source s, std::wstring& siid);
+    static void release_source(session_source s);
+    static HRESULT open_session(session_handle& h, session_source s);
+    static void close_session(session_handle& h);
+    static bool is_open(const session_handle& h) { return h.pSessionControl != NULL; }
+    static HRESULT register_session_events(session_handle& h, const std::weak_ptr<session_type>& wpAudioSession,
+        const std::weak_ptr<monitor_type>& wpAudioMonitor);
+    static HRESULT unregister_session_events(session_handle& h);
+    static HRESULT get_state(const session_handle& h, session_state_t& state);
+    static HRESULT get_volume(const session_handle& h, float& volume);
+    static HRESULT set_volume(session_handle& h, const float volume);
+    static void settle_new_session();
+
+    // Commands
+    template <class F>
+    static void run_command(const manager_handle&, command_t, F&& f) { f(); }
+};
 
-#ifdef VO_ENABLE_EVENTS 
-    long InitEvents();
-    long StopEvents();
-#endif
+extern template class BasicAudioSession<WasapiSessionBackend>;
+extern template class BasicAudioMonitor<WasapiSessionBackend>;
 
-    void poll(); /* AudioMonitor main thread loop */
-
-    HRESULT GetSessionManager(std::wstring& device_id);
-    HRESULT RefreshSessions();
-    void DeleteSessions();
-
-    HRESULT SaveSession(IAudioSessionControl* pNewSessionControl, const bool unref);
-    void DeleteSession(std::shared_ptr<AudioSession> spAudioSession); // Not used
-    void DeleteExpiredSessions(boost::system::error_code const& e,
-        std::shared_ptr<boost::asio::steady_timer> timer);
-    void ApplyMonitorSettings();
-    bool isSessionExcluded(const DWORD pid, std::wstring sid = L"");
-
-    void RemoveDeviceID(const std::wstring& device_id);
-    HRESULT InitDeviceID(const std::wstring& device_id);
-
-    IAudioSessionManager2* m_pSessionManager2;
-    IAudioSessionNotification* m_pSessionEvents;
-    std::wstring m_wsDeviceID; // current audio endpoint ID beign monitored.
-    static std::set<std::wstring> m_current_monitored_deviceids;
-    static std::mutex m_static_set_access;
-
-    // Settings
-    DWORD m_processid;
-    vo::monitor_settings m_settings;
-    const std::chrono::seconds m_inactive_timeout;
-    const std::chrono::seconds m_delete_expired_interval;
-    // Main sessions container type
-
-    // Used to delay or cancel all volume restores  session_this_pointer -> timer
-    typedef std::unordered_map<const AudioSession*, std::unique_ptr<boost::asio::steady_timer>> t_pending_restores;
-    t_pending_restores m_pending_restores;
-
-    bool m_auto_change_volume_flag; // SELFNOTE: we can delete this and use m_current_status, either way..
-    //monitor_status_t m_current_status;
-    std::atomic<monitor_status_t> m_current_status;
-    monitor_error_t m_error_status;
-
-    // Main sessions container type
-    typedef std::unordered_multimap<std::wstring, std::shared_ptr<AudioSession>> t_saved_sessions;
-    // Sessions currently Monitored, 
-    //	map of SID -> list of AudioSession pointers with unique SIID (SessionInstanceIdentifier) 
-    // You could look at it as group of different SIID sessions with the same SID.
-    // note: remember to delete its corresponding session in m_pending_restores
-    t_saved_sessions m_saved_sessions;
-    typedef std::pair<std::wstring, std::shared_ptr<AudioSession>> t_session_pair;
-
-    friend class AudioSession;
-    friend class AudioCallbackProxy; /* To select wich private methods others classes can access */
-
-    /* To sync Events with main class without "blocking" (async)
-        or we cause mem leaks on simultaneous callbacks (confirmed) */
-    std::shared_ptr<boost::asio::io_service> m_io;
-    bool m_abort;
-    std::thread m_thread_monitor; /* main class thread */
-
-    // used when posting synchronous function calls to audiomonitor
-    mutable std::mutex m_io_mutex;
-    mutable std::condition_variable m_cond;
-
-
-    // used to lock access to the class by only his own thread
-    mutable std::recursive_mutex m_mutex;
-};
+typedef BasicAudioSession<WasapiSessionBackend> AudioSession;
+typedef BasicAudioMonitor<WasapiSessionBackend> AudioMonitor;
+typedef BasicEndpointManager<WasapiSessionBackend> EndpointManager;
 
 } // end namespace vo
 
@@ -0,0 +1,412 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Multi endpoint AudioMonitor manager.
+
+    Monitors every rendering endpoint (or a chosen few) from one process on a single shared monitor_reactor,
+        each endpoint is a regular AudioMonitor serialized on its own strand.
+    Endpoints use the default settings unless they were given their own, stats are aggregated on demand.
+    With WatchEndpoints, endpoints plugged in or removed later are added and removed as they come,
+        endpoint notifications are handled on a small manager thread, never on the reactor.
+*/
+
+#ifndef VO_ENDPOINT_MANAGER_H
+#define VO_ENDPOINT_MANAGER_H
+
+#include "../volumeoptions/audiomonitor.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vo {
+
+/*
+    Thread safe, methods never run while holding a monitor strand, so they may be called from any thread
+        except from monitor handlers.
+*/
+template <class Backend>
+class BasicEndpointManager
+{
+public:
+    typedef BasicAudioMonitor<Backend> monitor_type;
+
+    typedef typename monitor_type::monitor_status_t monitor_status_t;
+
+    explicit BasicEndpointManager(unsigned threads = 2)
+        : m_reactor(monitor_type::CreateReactor(threads))
+        , m_status(monitor_status_t::STOPPED)
+        , m_state_mask(Backend::default_endpoint_state_mask)
+    {}
+    BasicEndpointManager(const BasicEndpointManager&) = delete;
+    BasicEndpointManager& operator=(const BasicEndpointManager&) = delete;
+
+    ~BasicEndpointManager()
+    {
+        if (m_events_io)
+        {
+            Backend::unwatch_endpoints(m_watch);
+            m_events_work.reset(); // late notifications post to an io_service nobody runs
+            if (m_events_thread.joinable())
+                m_events_thread.join();
+        }
+        RemoveAllEndpoints();
+    }
+
+    /*
+        AddAllEndpoints, then keeps the endpoint list in sync with the system: endpoints in dwStateMask that
+            show up later are added (and started if the manager is running), removed ones are removed.
+        Call it once.
+    */
+    HRESULT WatchEndpoints(DWORD dwStateMask = Backend::default_endpoint_state_mask)
+    {
+        if (m_events_io)
+            return S_FALSE;
+
+        m_state_mask = dwStateMask;
+        m_events_io = std::make_shared<boost::asio::io_service>();
+        m_events_work.reset(new boost::asio::io_service::work(*m_events_io));
+        m_events_thread = std::thread([this]()
+        {
+            Backend::thread_init();
+            m_events_io->run();
+        });
+
+        HRESULT hr = AddAllEndpoints(dwStateMask);
+
+        std::shared_ptr<boost::asio::io_service> io(m_events_io);
+        HRESULT hr_watch = Backend::watch_endpoints(m_watch, [this, io](endpoint_event_t e, const std::wstring& id)
+        {
+            std::wstring device_id(id);
+            io->post([this, e, device_id]() { OnEndpointEvent(e, device_id); });
+        });
+
+        return FAILED(hr_watch) ? hr_watch : hr;
+    }
+
+    /*
+        Adds every endpoint in dwStateMask not monitored yet, returns the first error but keeps going.
+        New endpoints are created STOPPED.
+    */
+    HRESULT AddAllEndpoints(DWORD dwStateMask = Backend::default_endpoint_state_mask)
+    {
+        std::map<std::wstring, std::wstring> audio_endpoints;
+        HRESULT hr = monitor_type::GetEndpointsInfo(audio_endpoints, dwStateMask);
+        if (FAILED(hr))
+            return hr;
+
+        for (const auto& e : audio_endpoints)
+        {
+            HRESULT hr_add = AddEndpoint(e.first);
+            if (FAILED(hr_add) && SUCCEEDED(hr))
+                hr = hr_add;
+        }
+
+        return hr;
+    }
+
+    /*
+        L"" adds the default endpoint, it is stored under its real id.
+        E_NOTFOUND if there is no such endpoint, E_INVALIDARG if it is already monitored (here or elsewhere).
+    */
+    HRESULT AddEndpoint(const std::wstring& device_id)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+
+        if (!device_id.empty() && m_endpoints.count(device_id))
+            return S_OK;
+
+        std::shared_ptr<monitor_type> monitor = monitor_type::create(m_reactor, device_id);
+        switch (monitor->GetErrorStatus())
+        {
+        case monitor_type::monitor_error_t::OK:
+            break;
+        case monitor_type::monitor_error_t::DEVICE_NOT_FOUND:
+            return E_NOTFOUND;
+        default:
+            return E_INVALIDARG;
+        }
+        if (monitor->GetDeviceID().empty())
+            return E_FAIL; // backend error, already reported
+        if (device_id.empty())
+            monitor->ChangeDeviceID(monitor->GetDeviceID()); // stays on this endpoint, its key
+
+        if (m_default_settings)
+        {
+            vo::monitor_settings s(*m_default_settings);
+            monitor->SetSettings(s);
+        }
+
+        if (m_journal)
+            monitor->SetJournal(m_journal);
+
+        if (m_status == monitor_status_t::RUNNING)
+            monitor->Start();
+
+        endpoint& e = m_endpoints[monitor->GetDeviceID()];
+        e.monitor = std::move(monitor);
+        e.own_settings = false;
+
+        return S_OK;
+    }
+
+    // The monitor is stopped and destroyed, unless someone else still holds it (GetMonitor).
+    void RemoveEndpoint(const std::wstring& device_id)
+    {
+        std::shared_ptr<monitor_type> monitor;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            auto it = m_endpoints.find(device_id);
+            if (it == m_endpoints.end())
+                return;
+            monitor = std::move(it->second.monitor);
+            m_endpoints.erase(it);
+        }
+    }
+
+    void RemoveAllEndpoints()
+    {
+        std::map<std::wstring, endpoint> endpoints;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            endpoints.swap(m_endpoints);
+        }
+    }
+
+    std::shared_ptr<monitor_type> GetMonitor(const std::wstring& device_id) const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        auto it = m_endpoints.find(device_id);
+        return (it != m_endpoints.end()) ? it->second.monitor : nullptr;
+    }
+
+    std::vector<std::wstring> GetEndpoints() const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::vector<std::wstring> ids;
+        ids.reserve(m_endpoints.size());
+        for (const auto& e : m_endpoints)
+            ids.push_back(e.first);
+        return ids;
+    }
+
+    // One journal for every endpoint, SIDs include the endpoint id. Set it before Start.
+    void SetJournal(const std::shared_ptr<volume_journal>& journal)
+    {
+        std::vector<std::shared_ptr<monitor_type>> targets;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            m_journal = journal;
+            for (const auto& e : m_endpoints)
+                targets.push_back(e.second.monitor);
+        }
+        for (auto& m : targets)
+            m->SetJournal(journal);
+    }
+
+    // Applied to endpoints without their own settings, now and when added.
+    void SetDefaultSettings(const vo::monitor_settings& settings)
+    {
+        std::vector<std::shared_ptr<monitor_type>> targets;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            m_default_settings = std::make_shared<const vo::monitor_settings>(settings);
+            for (const auto& e : m_endpoints)
+            {
+                if (!e.second.own_settings)
+                    targets.push_back(e.second.monitor);
+            }
+        }
+        for (auto& m : targets)
+        {
+            vo::monitor_settings s(settings);
+            m->SetSettings(s);
+        }
+    }
+
+    // Returns false if the endpoint is not monitored.
+    bool SetEndpointSettings(const std::wstring& device_id, const vo::monitor_settings& settings)
+    {
+        std::shared_ptr<monitor_type> monitor;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            auto it = m_endpoints.find(device_id);
+            if (it == m_endpoints.end())
+                return false;
+            it->second.own_settings = true;
+            monitor = it->second.monitor;
+        }
+        vo::monitor_settings s(settings);
+        monitor->SetSettings(s);
+        return true;
+    }
+
+    // Back to the default settings.
+    bool ClearEndpointSettings(const std::wstring& device_id)
+    {
+        std::shared_ptr<monitor_type> monitor;
+        std::shared_ptr<const vo::monitor_settings> settings;
+        {
+            std::lock_guard<std::mutex> l(m_mutex);
+            auto it = m_endpoints.find(device_id);
+            if (it == m_endpoints.end())
+                return false;
+            it->second.own_settings = false;
+            monitor = it->second.monitor;
+            settings = m_default_settings;
+        }
+        vo::monitor_settings s(settings ? *settings : vo::monitor_settings());
+        monitor->SetSettings(s);
+        return true;
+    }
+
+    /* Same as the monitor methods on every endpoint, return the first non zero result */
+    long Start() { SetStatus(monitor_status_t::RUNNING); return ForEach(&monitor_type::Start); }
+    long Pause() { SetStatus(monitor_status_t::PAUSED); return ForEach(&monitor_type::Pause); }
+    long Stop() { SetStatus(monitor_status_t::STOPPED); return ForEach(&monitor_type::Stop); }
+
+    struct endpoint_stats
+    {
+        size_t endpoints;
+        size_t running;
+        typename monitor_type::volume_write_stats volume;
+        typename monitor_type::command_stats commands;
+        typename monitor_type::sync_call_stats sync; // max_ns is the max of all endpoints
+    };
+    endpoint_stats GetStats() const
+    {
+        endpoint_stats r = {};
+        for (auto& m : Monitors())
+        {
+            r.endpoints++;
+            if (m->GetStatus() == monitor_type::monitor_status_t::RUNNING)
+                r.running++;
+
+            const auto v = m->GetVolumeWriteStats();
+            r.volume.writes += v.writes;
+            r.volume.throttled += v.throttled;
+
+            const auto c = m->GetCommandStats();
+            r.commands.commands += c.commands;
+            r.commands.batches += c.batches;
+            r.commands.overflows += c.overflows;
+            r.commands.volume_changes += c.volume_changes;
+            r.commands.volume_coalesced += c.volume_coalesced;
+            r.commands.volume_applied += c.volume_applied;
+
+            const auto s = m->GetSyncCallStats();
+            r.sync.calls += s.calls;
+            r.sync.total_ns += s.total_ns;
+            r.sync.max_ns = (std::max)(r.sync.max_ns, s.max_ns);
+        }
+        return r;
+    }
+
+    const std::shared_ptr<monitor_reactor>& get_reactor() const { return m_reactor; }
+
+private:
+    struct endpoint
+    {
+        std::shared_ptr<monitor_type> monitor;
+        bool own_settings;
+    };
+
+    std::vector<std::shared_ptr<monitor_type>> Monitors() const
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        std::vector<std::shared_ptr<monitor_type>> monitors;
+        monitors.reserve(m_endpoints.size());
+        for (const auto& e : m_endpoints)
+            monitors.push_back(e.second.monitor);
+        return monitors;
+    }
+
+    void SetStatus(monitor_status_t status)
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        m_status = status;
+    }
+
+    // manager thread
+    void OnEndpointEvent(endpoint_event_t e, const std::wstring& device_id)
+    {
+        switch (e)
+        {
+        case endpoint_event_t::ADDED:
+        {
+            // notifications do not tell the data flow or state, ask for the endpoints we want.
+            std::map<std::wstring, std::wstring> audio_endpoints;
+            if (SUCCEEDED(monitor_type::GetEndpointsInfo(audio_endpoints, m_state_mask)) &&
+                audio_endpoints.count(device_id))
+                AddEndpoint(device_id);
+            break;
+        }
+        case endpoint_event_t::REMOVED:
+            RemoveEndpoint(device_id);
+            break;
+        default:
+            break; // every endpoint has its own monitor already
+        }
+    }
+
+    long ForEach(long (monitor_type::*f)())
+    {
+        long ret = 0;
+        for (auto& m : Monitors())
+        {
+            long r = ((*m).*f)();
+            if (r && !ret)
+                ret = r;
+        }
+        return ret;
+    }
+
+    const std::shared_ptr<monitor_reactor> m_reactor; // shared by all endpoint monitors
+
+    mutable std::mutex m_mutex;
+    std::map<std::wstring, endpoint> m_endpoints; // by device id
+    std::shared_ptr<const vo::monitor_settings> m_default_settings; // null until set, monitor defaults
+    monitor_status_t m_status; // last Start/Pause/Stop, endpoints added later are brought to it
+    std::shared_ptr<volume_journal> m_journal;
+
+    // WatchEndpoints
+    DWORD m_state_mask;
+    typename Backend::endpoint_watch m_watch;
+    std::shared_ptr<boost::asio::io_service> m_events_io; // null if not watching
+    std::unique_ptr<boost::asio::io_service::work> m_events_work;
+    std::thread m_events_thread;
+};
+
+} // end namespace vo
+
+#endif
@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Bounded lock free multi producer, single consumer ring.
+
+    Backend callback threads hand commands to the monitor thread through it without taking a lock or
+        allocating, see BasicAudioMonitor::PushCommand.
+*/
+
+#ifndef VO_MPSC_RING_H
+#define VO_MPSC_RING_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace vo {
+
+/*
+    Fixed capacity ring of T records, each cell carries a sequence number telling producers and the
+        consumer whose turn it is (Vyukov's bounded queue), so a push is one CAS on the tail and a pop
+        touches no shared counter at all.
+
+    try_push may be called from any thread and never blocks, it fails when the ring is full.
+    try_pop must only be called from a single consumer thread, it fails when the ring is empty or the
+        next record is still being written by its producer (later records wait behind it).
+*/
+template <class T>
+class mpsc_ring
+{
+    struct cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    enum { cache_line = 64 };
+
+public:
+    // capacity is rounded up to a power of two.
+    explicit mpsc_ring(size_t capacity)
+        : m_head(0)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        m_mask = n - 1;
+
+        m_cells.reset(new cell[n]);
+        for (size_t i = 0; i < n; ++i)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+    }
+
+    mpsc_ring(const mpsc_ring&) = delete;
+    mpsc_ring& operator=(const mpsc_ring&) = delete;
+
+    size_t capacity() const { return m_mask + 1; }
+
+    /* any thread, v is left untouched if the ring is full */
+    bool try_push(T&& v)
+    {
+        cell* c;
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            c = &m_cells[pos & m_mask];
+            const size_t seq = c->sequence.load(std::memory_order_acquire);
+            const ptrdiff_t dif = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+            if (dif == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false; // full, the consumer has not freed this cell yet
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+
+        c->value = std::move(v);
+        c->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* consumer thread only */
+    bool try_pop(T& v)
+    {
+        cell& c = m_cells[m_head & m_mask];
+        const size_t seq = c.sequence.load(std::memory_order_acquire);
+        if (seq != m_head + 1)
+            return false;
+
+        v = std::move(c.value);
+        c.value = T(); // drop what the record references now, not when the cell is reused
+        c.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+        ++m_head;
+        return true;
+    }
+
+private:
+    std::unique_ptr<cell[]> m_cells;
+    size_t m_mask;
+
+    // producers and consumer counters on their own cache lines
+    char m_pad0[cache_line];
+    std::atomic<size_t> m_tail;
+    char m_pad1[cache_line - sizeof(std::atomic<size_t>)];
+    size_t m_head;
+    char m_pad2[cache_line - sizeof(size_t)];
+};
+
+} // end namespace vo
+
+#endif
@@ -0,0 +1,92 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Compiled per application session settings.
+
+    monitor_settings::ses_individual_settings maps executable names to their own session settings.
+    AudioMonitor compiles the map once per SetSettings into a perfect hash, each saved session
+        then finds its profile with two hashes of its executable name and one compare, however many
+        profiles are configured.
+*/
+
+#ifndef VO_SESSION_PROFILES_H
+#define VO_SESSION_PROFILES_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../volumeoptions/vo_settings.h"
+
+namespace vo {
+
+/*
+    Hash and displace table over case folded executable names, built once, read only afterwards.
+
+    Names hash to a bucket, every bucket stores the seed that sends its names to free slots, so a
+        lookup never probes. Unknown names land on some slot and fail the compare.
+*/
+class profile_table
+{
+public:
+    enum : uint32_t { no_profile = 0xFFFFFFFF };
+
+    profile_table(); // no profiles
+    explicit profile_table(const std::map<std::wstring, session_settings>& profiles);
+
+    bool empty() const { return m_names.empty(); }
+    size_t size() const { return m_names.size(); }
+
+    // profile index of a case folded executable name, or no_profile.
+    uint32_t find(const std::wstring& name) const;
+    const session_settings& settings(uint32_t profile) const { return m_settings[profile]; }
+
+    // executable name of a case folded SndVol SID, the last component of its process path.
+    static std::wstring process_name(const std::wstring& lower_sid);
+
+    // true if both maps compile to the same table.
+    static bool same_profiles(const std::map<std::wstring, session_settings>& a,
+        const std::map<std::wstring, session_settings>& b);
+
+private:
+    static uint32_t hash(const std::wstring& s, uint32_t seed);
+
+    std::vector<uint32_t> m_seeds; // by bucket, 0 = bucket is empty
+    std::vector<uint32_t> m_slots; // profile index, or no_profile
+    std::vector<std::wstring> m_names; // by profile index
+    std::vector<session_settings> m_settings; // by profile index
+};
+
+} // end namespace vo
+
+#endif
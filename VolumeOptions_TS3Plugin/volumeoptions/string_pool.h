@@ -0,0 +1,195 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Process wide string interning pool.
+
+    SIDs, SIIDs and process names are long wide strings that reach the monitor over and over
+        (enumeration, new session notifications, settings reapplication).
+    The pool stores each distinct string once together with its lowercase form and hands out
+        interned_wstring handles, comparing or hashing a handle never touches the characters.
+    Every entry also owns a small dense id, reused after the last handle is gone, used to index flat
+        tables (see session_table.h).
+*/
+
+#ifndef VO_STRING_POOL_H
+#define VO_STRING_POOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace vo {
+
+typedef uint32_t string_id_t;
+const string_id_t invalid_string_id = 0xFFFFFFFF;
+
+class string_pool;
+
+// Lowercase form used by the pool, anything matched against interned_wstring::lower() must use it too.
+std::wstring fold_case(const std::wstring& s);
+
+namespace detail {
+
+struct pooled_wstring
+{
+    std::wstring str;
+    std::wstring lower;
+    string_id_t id;
+    std::atomic<uint32_t> refs;
+    string_pool* pool;
+};
+
+} // end namespace detail
+
+/*
+    Refcounted handle to a pooled string, default constructed handles hold no string.
+
+    Copies only touch an atomic counter, handles can be freely shared between threads.
+    Two handles of the same pool are equal only if their strings are equal.
+*/
+class interned_wstring
+{
+public:
+    interned_wstring() : m_e(nullptr) {}
+    interned_wstring(const interned_wstring& o) : m_e(o.m_e)
+    {
+        if (m_e)
+            m_e->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    interned_wstring(interned_wstring&& o) : m_e(o.m_e) { o.m_e = nullptr; }
+    interned_wstring& operator=(interned_wstring o)
+    {
+        std::swap(m_e, o.m_e);
+        return *this;
+    }
+    ~interned_wstring() { reset(); }
+
+    void reset();
+
+    bool empty() const { return m_e == nullptr; }
+    const std::wstring& str() const { return m_e ? m_e->str : empty_string(); }
+    const std::wstring& lower() const { return m_e ? m_e->lower : empty_string(); }
+    string_id_t id() const { return m_e ? m_e->id : invalid_string_id; }
+
+    bool operator==(const interned_wstring& o) const { return m_e == o.m_e; }
+    bool operator!=(const interned_wstring& o) const { return m_e != o.m_e; }
+
+    size_t hash() const { return std::hash<const void*>()(m_e); }
+
+private:
+    friend class string_pool;
+    explicit interned_wstring(detail::pooled_wstring* e) : m_e(e) {} // adopts a reference
+
+    static const std::wstring& empty_string();
+
+    detail::pooled_wstring* m_e;
+};
+
+/*
+    Thread safe pool of interned_wstring, use global() unless an isolated pool is needed.
+
+    Interning and the release of the last handle of a string lock the pool, everything else is lock free.
+    A pool must outlive all of its handles.
+*/
+class string_pool
+{
+public:
+    string_pool() {}
+    string_pool(const string_pool&) = delete;
+    string_pool& operator=(const string_pool&) = delete;
+
+    // never destroyed, handles held by static objects can outlive everything else.
+    static string_pool& global();
+
+    interned_wstring intern(const std::wstring& s);
+    interned_wstring find(const std::wstring& s) const; // empty handle if s is not pooled, never inserts
+
+    size_t size() const;
+
+private:
+    friend class interned_wstring;
+    void release_last(detail::pooled_wstring* e);
+
+    struct str_ptr_hash
+    {
+        size_t operator()(const std::wstring* s) const { return std::hash<std::wstring>()(*s); }
+    };
+    struct str_ptr_equal
+    {
+        bool operator()(const std::wstring* a, const std::wstring* b) const { return *a == *b; }
+    };
+
+    mutable std::mutex m_mutex;
+    // keys point to the entry own string, each string is stored once.
+    std::unordered_map<const std::wstring*, detail::pooled_wstring*, str_ptr_hash, str_ptr_equal> m_index;
+    std::vector<std::unique_ptr<detail::pooled_wstring>> m_entries; // indexed by id
+    std::vector<string_id_t> m_free;
+};
+
+/*
+    Only the last reference goes through the pool lock, so a string being released can never
+        be handed out again by intern() while it is erased.
+*/
+inline void interned_wstring::reset()
+{
+    if (!m_e)
+        return;
+
+    uint32_t refs = m_e->refs.load(std::memory_order_relaxed);
+    while (refs > 1)
+    {
+        if (m_e->refs.compare_exchange_weak(refs, refs - 1, std::memory_order_acq_rel))
+        {
+            m_e = nullptr;
+            return;
+        }
+    }
+
+    m_e->pool->release_last(m_e);
+    m_e = nullptr;
+}
+
+} // end namespace vo
+
+namespace std {
+template <> struct hash<vo::interned_wstring>
+{
+    size_t operator()(const vo::interned_wstring& s) const { return s.hash(); }
+};
+} // end namespace std
+
+#endif
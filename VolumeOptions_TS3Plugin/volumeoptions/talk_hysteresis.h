@@ -0,0 +1,209 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Talk hysteresis, debounces VolumeOptions talk status before it reaches AudioMonitor.
+
+    Every duck (AudioMonitor::Start) and release (Pause) is a volume pass over all sessions, voice activated
+        clients flapping their talk status every few hundred milliseconds would cause one per flap.
+*/
+
+#ifndef VO_TALK_HYSTERESIS_H
+#define VO_TALK_HYSTERESIS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace vo {
+
+/*
+    Duck/release state machine fed with "someone enabled is talking" transitions.
+
+    duck_delay      talking must last this long before ducking, shorter blips never duck.
+    min_duck        once ducked stay ducked at least this long.
+    release_hold    after the last talker stops wait this long before releasing, talk resumed inside it
+                    keeps the duck.
+
+    All zero reproduces the plain behaviour, duck on talk, release on silence.
+    update and poll return the action to take now, next_deadline tells when poll has something to do.
+    Not thread safe, VolumeOptions uses it under its mutex.
+*/
+class talk_hysteresis
+{
+public:
+    typedef std::chrono::steady_clock clock;
+    enum class action_t { NONE, DUCK, RELEASE };
+
+    struct timing
+    {
+        timing()
+            : duck_delay(0)
+            , min_duck(0)
+            , release_hold(0)
+        {}
+
+        std::chrono::milliseconds duck_delay;
+        std::chrono::milliseconds min_duck;
+        std::chrono::milliseconds release_hold;
+    };
+
+    struct stats
+    {
+        stats() : transitions(0), ducks(0), releases(0), flaps(0), passes_saved(0) {}
+
+        uint64_t transitions;  // talk status changes fed to update
+        uint64_t ducks;        // DUCK actions returned
+        uint64_t releases;     // RELEASE actions returned
+        uint64_t flaps;        // transitions absorbed inside duck_delay or release_hold
+        uint64_t passes_saved; // volume passes (duck + release) those flaps did not cause
+    };
+
+    talk_hysteresis()
+        : m_state(state_t::RELEASED)
+        , m_deadline(clock::time_point::max())
+    {}
+
+    void set_timing(const timing& t) { m_timing = t; }
+    const timing& get_timing() const { return m_timing; }
+    const stats& get_stats() const { return m_stats; }
+
+    // true while AudioMonitor should be ducking (including release_hold).
+    bool ducked() const { return (m_state == state_t::DUCKED) || (m_state == state_t::HOLD); }
+
+    // clock::time_point::max() if nothing is pending.
+    clock::time_point next_deadline() const { return m_deadline; }
+
+    /* talk status changed */
+    action_t update(bool talking, clock::time_point now)
+    {
+        m_stats.transitions++;
+
+        if (talking)
+        {
+            switch (m_state)
+            {
+            case state_t::RELEASED:
+                if (m_timing.duck_delay.count() <= 0)
+                    return duck(now);
+                m_state = state_t::PENDING;
+                m_deadline = now + m_timing.duck_delay;
+                break;
+            case state_t::HOLD:
+                // talk resumed before the release, neither the release nor the next duck happen.
+                m_state = state_t::DUCKED;
+                m_deadline = clock::time_point::max();
+                flap();
+                break;
+            default:
+                break;
+            }
+        }
+        else
+        {
+            switch (m_state)
+            {
+            case state_t::PENDING:
+                // a blip shorter than duck_delay.
+                m_state = state_t::RELEASED;
+                m_deadline = clock::time_point::max();
+                flap();
+                break;
+            case state_t::DUCKED:
+                m_deadline = std::max(now + m_timing.release_hold, m_ducked_at + m_timing.min_duck);
+                if (m_deadline <= now)
+                    return release();
+                m_state = state_t::HOLD;
+                break;
+            default:
+                break;
+            }
+        }
+
+        return action_t::NONE;
+    }
+
+    /* call at next_deadline */
+    action_t poll(clock::time_point now)
+    {
+        if (now < m_deadline)
+            return action_t::NONE;
+
+        if (m_state == state_t::PENDING)
+            return duck(now);
+        if (m_state == state_t::HOLD)
+            return release();
+        return action_t::NONE;
+    }
+
+    /* AudioMonitor was started or stopped behind our back (plugin enabled or disabled) */
+    void reset(bool ducked, clock::time_point now)
+    {
+        m_state = ducked ? state_t::DUCKED : state_t::RELEASED;
+        m_ducked_at = now;
+        m_deadline = clock::time_point::max();
+    }
+
+private:
+    enum class state_t { RELEASED, PENDING, DUCKED, HOLD };
+
+    action_t duck(clock::time_point now)
+    {
+        m_state = state_t::DUCKED;
+        m_ducked_at = now;
+        m_deadline = clock::time_point::max();
+        m_stats.ducks++;
+        return action_t::DUCK;
+    }
+
+    action_t release()
+    {
+        m_state = state_t::RELEASED;
+        m_deadline = clock::time_point::max();
+        m_stats.releases++;
+        return action_t::RELEASE;
+    }
+
+    void flap()
+    {
+        m_stats.flaps++;
+        m_stats.passes_saved += 2;
+    }
+
+    timing m_timing;
+    stats m_stats;
+    state_t m_state;
+    clock::time_point m_ducked_at;
+    clock::time_point m_deadline; // PENDING: duck at, HOLD: release at
+};
+
+} // end namespace vo
+
+#endif
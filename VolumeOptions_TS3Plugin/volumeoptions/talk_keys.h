@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Compact integer identities for the VolumeOptions talk state.
+
+    TS3 names virtual servers and clients by long unique id strings, channel ids are only unique within
+        their server. Each string is interned once into a small dense key, talk state containers then
+        hash integers and a talk event from a known client allocates nothing.
+*/
+
+#ifndef VO_TALK_KEYS_H
+#define VO_TALK_KEYS_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vo {
+
+typedef uint32_t talk_key_t;
+const talk_key_t invalid_talk_key = 0xFFFFFFFF;
+
+/*
+    A channel, its server key plus the server local channel id.
+*/
+struct channel_key
+{
+    channel_key() : server(invalid_talk_key), channel(0) {}
+    channel_key(talk_key_t s, uint64_t c) : server(s), channel(c) {}
+
+    bool operator==(const channel_key& o) const { return (server == o.server) && (channel == o.channel); }
+    bool operator!=(const channel_key& o) const { return !(*this == o); }
+
+    talk_key_t server;
+    uint64_t channel;
+};
+
+struct channel_key_hash
+{
+    size_t operator()(const channel_key& k) const
+    {
+        return std::hash<uint64_t>()(k.channel * 0x9E3779B97F4A7C15ull ^ k.server);
+    }
+};
+
+/*
+    Dense keys of strings, in the order they were first seen.
+
+    Keys are never released, a TS3 client meets a few servers and at most some thousands of clients per run.
+    Not thread safe, VolumeOptions uses it under its mutex.
+*/
+class talk_key_index
+{
+public:
+    // key of s, allocated the first time s is seen.
+    talk_key_t intern(const std::string& s)
+    {
+        auto it = m_keys.find(s);
+        if (it != m_keys.end())
+            return it->second;
+
+        const talk_key_t k = static_cast<talk_key_t>(m_names.size());
+        m_keys.emplace(s, k);
+        m_names.push_back(s);
+        return k;
+    }
+
+    // key of s or invalid_talk_key, never allocates one.
+    talk_key_t find(const std::string& s) const
+    {
+        auto it = m_keys.find(s);
+        return (it != m_keys.end()) ? it->second : invalid_talk_key;
+    }
+
+    const std::string& name(talk_key_t k) const { return m_names[k]; }
+    size_t size() const { return m_names.size(); }
+
+private:
+    std::unordered_map<std::string, talk_key_t> m_keys;
+    std::vector<std::string> m_names; // by key
+};
+
+} // end namespace vo
+
+#endif
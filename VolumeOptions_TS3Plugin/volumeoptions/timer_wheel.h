@@ -0,0 +1,392 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Hierarchical timer wheel.
+
+    AudioMonitor multiplexes all its timers (volume restore delays, expiry checks, ramp ticks) on one
+        wheel and keeps a single asio timer armed for the next due slot, so a burst of restores costs
+        no allocation nor io_service timer queue work.
+*/
+
+#ifndef VO_TIMER_WHEEL_H
+#define VO_TIMER_WHEEL_H
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace vo {
+
+/*
+    Stable reference to a scheduled timer, fired or cancelled timers never match.
+*/
+struct timer_handle
+{
+    timer_handle() : index(0xFFFFFFFF), generation(0) {}
+    timer_handle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+    bool valid() const { return index != 0xFFFFFFFF; }
+
+    uint32_t index;
+    uint32_t generation;
+};
+
+namespace detail {
+
+    // index of the lowest set bit, x != 0
+    inline unsigned lowest_bit(uint64_t x)
+    {
+        assert(x != 0);
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long i;
+        _BitScanForward64(&i, x);
+        return i;
+#elif defined(_MSC_VER)
+        unsigned long i;
+        if (_BitScanForward(&i, static_cast<unsigned long>(x)))
+            return i;
+        _BitScanForward(&i, static_cast<unsigned long>(x >> 32));
+        return i + 32;
+#else
+        return static_cast<unsigned>(__builtin_ctzll(x));
+#endif
+    }
+}
+
+/*
+    Timers of value T bucketed by due tick on 4 levels of 64 slots, a level L slot spans 64^L ticks.
+
+    A timer sits on the lowest level where its due tick and the current tick differ, when the wheel
+        reaches its slot it cascades down one or more levels, or fires if it is on level 0. Timers further
+        than the top level go to an overflow list rechecked every 64^4 ticks.
+    schedule and cancel are O(1), advance jumps straight to the next occupied slot using per level
+        occupancy bitmaps, an idle wheel costs nothing however long it sleeps.
+
+    The wheel has no clock or thread of its own, the owner calls advance when next_due() is reached.
+    Not thread safe.
+*/
+template <class T>
+class timer_wheel
+{
+    enum : uint32_t { npos = 0xFFFFFFFF };
+    enum : unsigned
+    {
+        slot_bits = 6,
+        slots = 1 << slot_bits,
+        levels = 4,
+        overflow_list = levels * slots, // beyond the top level
+        firing_list,                    // due this tick, being fired
+        lists,
+        no_list = lists
+    };
+
+    struct node
+    {
+        T value;
+        uint64_t due; // tick
+        uint32_t generation;
+        uint32_t prev;
+        uint32_t next;
+        unsigned list;
+    };
+
+public:
+    typedef std::chrono::steady_clock clock;
+
+    explicit timer_wheel(clock::duration resolution = std::chrono::milliseconds(1),
+        clock::time_point origin = clock::now())
+        : m_resolution(resolution)
+        , m_origin(origin)
+        , m_now(0)
+        , m_size(0)
+    {
+        assert(resolution > clock::duration::zero());
+        for (auto& h : m_heads)
+            h = npos;
+        for (auto& o : m_occupied)
+            o = 0;
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /* 'when' is rounded up to the wheel resolution, times already reached fire on the next tick */
+    timer_handle schedule(clock::time_point when, const T& value)
+    {
+        uint64_t due = to_tick(when);
+        if (due <= m_now)
+            due = m_now + 1;
+
+        uint32_t i;
+        if (!m_free.empty())
+        {
+            i = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            i = static_cast<uint32_t>(m_nodes.size());
+            m_nodes.push_back(node{ T(), 0, 0, npos, npos, no_list });
+        }
+
+        node& n = m_nodes[i];
+        n.value = value;
+        n.due = due;
+        place(i);
+        m_size++;
+
+        return timer_handle(i, n.generation);
+    }
+
+    bool pending(const timer_handle& h) const
+    {
+        return (h.index < m_nodes.size()) && (m_nodes[h.index].list != no_list) &&
+            (m_nodes[h.index].generation == h.generation);
+    }
+
+    /* time a pending timer fires at (rounded up to the wheel resolution), time_point::max() if not pending */
+    clock::time_point due(const timer_handle& h) const
+    {
+        if (!pending(h))
+            return clock::time_point::max();
+        return m_origin + m_resolution * static_cast<clock::duration::rep>(m_nodes[h.index].due);
+    }
+
+    /* resets h, returns false if it was not pending */
+    bool cancel(timer_handle& h)
+    {
+        const bool was_pending = pending(h);
+        if (was_pending)
+        {
+            unlink(h.index);
+            release(h.index);
+        }
+        h = timer_handle();
+        return was_pending;
+    }
+
+    /* time the wheel next has work (fire or cascade) at, time_point::max() if empty */
+    clock::time_point next_due() const
+    {
+        const uint64_t t = next_tick();
+        if (t == UINT64_MAX)
+            return clock::time_point::max();
+        return m_origin + m_resolution * static_cast<clock::duration::rep>(t);
+    }
+
+    /*
+        Fires every timer due at 'now' calling f(T&), returns how many fired.
+        f may schedule and cancel timers, even others due in the same tick.
+    */
+    template <class F>
+    size_t advance(clock::time_point now, F f)
+    {
+        const uint64_t target = (now > m_origin) ? static_cast<uint64_t>((now - m_origin) / m_resolution) : 0;
+        size_t fired = 0;
+
+        for (;;)
+        {
+            const uint64_t t = next_tick();
+            if ((t == UINT64_MAX) || (t > target))
+                break;
+            m_now = t;
+
+            if ((t & (top_span() - 1)) == 0)
+                cascade(overflow_list);
+            for (unsigned level = levels - 1; level > 0; --level)
+            {
+                if ((t & ((uint64_t(1) << (slot_bits * level)) - 1)) == 0)
+                    cascade(level * slots + ((t >> (slot_bits * level)) & (slots - 1)));
+            }
+
+            // detach the slot so callbacks can not add to it, cancels still unlink from the firing list
+            move_list(static_cast<unsigned>(t & (slots - 1)), firing_list);
+            while (m_heads[firing_list] != npos)
+            {
+                const uint32_t i = m_heads[firing_list];
+                unlink(i);
+                T value(std::move(m_nodes[i].value));
+                release(i);
+                fired++;
+                f(value);
+            }
+        }
+
+        if (m_now < target)
+            m_now = target;
+        return fired;
+    }
+
+private:
+    static uint64_t top_span() { return uint64_t(1) << (slot_bits * levels); }
+
+    uint64_t to_tick(clock::time_point when) const
+    {
+        if (when <= m_origin)
+            return 0;
+        if (when == clock::time_point::max())
+            return UINT64_MAX - 1;
+        const clock::duration d = when - m_origin;
+        return static_cast<uint64_t>((d + m_resolution - clock::duration(1)) / m_resolution);
+    }
+
+    /*
+        Next tick with a level 0 slot to fire or a higher slot to cascade.
+        Every timer of level L shares the digits above L with m_now and has a greater digit L,
+            so the first occupied slot after the current digit of the lowest non empty level is the answer.
+    */
+    uint64_t next_tick() const
+    {
+        for (unsigned level = 0; level < levels; ++level)
+        {
+            const unsigned shift = slot_bits * level;
+            const unsigned digit = static_cast<unsigned>((m_now >> shift) & (slots - 1));
+            const uint64_t ahead = (digit == slots - 1) ? 0 : (m_occupied[level] & (~uint64_t(0) << (digit + 1)));
+            if (ahead)
+            {
+                const uint64_t block = (m_now >> (shift + slot_bits)) << (shift + slot_bits);
+                return block | (uint64_t(detail::lowest_bit(ahead)) << shift);
+            }
+        }
+
+        if (m_heads[overflow_list] != npos)
+            return (m_now | (top_span() - 1)) + 1;
+
+        return UINT64_MAX;
+    }
+
+    void place(uint32_t i)
+    {
+        node& n = m_nodes[i];
+        assert(n.due > m_now);
+
+        const uint64_t x = n.due ^ m_now;
+        if (x >= top_span())
+        {
+            link(i, overflow_list);
+            return;
+        }
+
+        unsigned level = 0;
+        while (x >> (slot_bits * (level + 1)))
+            level++;
+        const unsigned slot = static_cast<unsigned>((n.due >> (slot_bits * level)) & (slots - 1));
+        link(i, level * slots + slot);
+    }
+
+    void cascade(unsigned list)
+    {
+        // detached first, overflow timers still out of range go back to the same list.
+        uint32_t i = m_heads[list];
+        m_heads[list] = npos;
+        if (list < overflow_list)
+            m_occupied[list / slots] &= ~(uint64_t(1) << (list % slots));
+
+        while (i != npos)
+        {
+            const uint32_t next = m_nodes[i].next;
+            if (m_nodes[i].due <= m_now)
+                link(i, static_cast<unsigned>(m_now & (slots - 1))); // due now, fires with level 0
+            else
+                place(i);
+            i = next;
+        }
+    }
+
+    void move_list(unsigned from, unsigned to)
+    {
+        while (m_heads[from] != npos)
+        {
+            const uint32_t i = m_heads[from];
+            unlink(i);
+            link(i, to);
+        }
+    }
+
+    void link(uint32_t i, unsigned list)
+    {
+        node& n = m_nodes[i];
+        n.list = list;
+        n.prev = npos;
+        n.next = m_heads[list];
+        if (n.next != npos)
+            m_nodes[n.next].prev = i;
+        m_heads[list] = i;
+        if (list < overflow_list)
+            m_occupied[list / slots] |= uint64_t(1) << (list % slots);
+    }
+
+    void unlink(uint32_t i)
+    {
+        node& n = m_nodes[i];
+        if (n.prev != npos)
+            m_nodes[n.prev].next = n.next;
+        else
+            m_heads[n.list] = n.next;
+        if (n.next != npos)
+            m_nodes[n.next].prev = n.prev;
+
+        if ((n.list < overflow_list) && (m_heads[n.list] == npos))
+            m_occupied[n.list / slots] &= ~(uint64_t(1) << (n.list % slots));
+
+        n.prev = n.next = npos;
+        n.list = no_list;
+    }
+
+    void release(uint32_t i)
+    {
+        node& n = m_nodes[i];
+        n.value = T();
+        n.generation++;
+        m_free.push_back(i);
+        m_size--;
+    }
+
+    const clock::duration m_resolution;
+    const clock::time_point m_origin;
+    uint64_t m_now; // last tick advanced to, every timer due at or before it has fired
+
+    std::vector<node> m_nodes;
+    std::vector<uint32_t> m_free;
+    uint32_t m_heads[lists];
+    uint64_t m_occupied[levels]; // non empty slots per level
+    size_t m_size;
+};
+
+} // end namespace vo
+
+#endif
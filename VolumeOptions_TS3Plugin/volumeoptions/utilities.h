@@ -43,6 +43,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif 
 
 #include <chrono>
+#include <locale>
 
 ///////////////////////////////////////////////////////
 
@@ -31,11 +31,15 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef SOUND_PLUGIN_H
 #define SOUND_PLUGIN_H
 
+#include <atomic>
 #include <fstream>
+#include <memory>
 #include <mutex>
+#include <thread>
 #include <unordered_set>
 #include <unordered_map>
 #include <string>
+#include <vector>
 
 #include "stdint.h"
 
@@ -45,6 +49,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "../volumeoptions/audiomonitor_wasapi.h"
 #endif
 #include "../volumeoptions/vo_settings.h"
+#include "../volumeoptions/talk_hysteresis.h"
+#include "../volumeoptions/talk_keys.h"
+#include "../volumeoptions/mpsc_ring.h"
 
 namespace vo {
 
@@ -73,28 +80,66 @@ public:
     typedef uint64_t channelID_t;
 
     // talk status, true if talking, false if not talking anymore. optional ownclient = true if we are talking
-    int process_talk(const bool talk_status, const uniqueServerID_t uniqueServerID, const channelID_t channelID,
-        const uniqueClientID_t uniqueClientID, const bool ownclient = false);
-
-    vo::volume_options_settings get_current_settings() const;
+    // never waits on AudioMonitor, the event is queued and applied on m_hold_thread.
+    int process_talk(const bool talk_status, const uniqueServerID_t& uniqueServerID, const channelID_t channelID,
+        const uniqueClientID_t& uniqueClientID, const bool ownclient = false);
+
+    // one onTalkStatusChangeEvent, same meaning as the process_talk arguments.
+    struct talk_event
+    {
+        bool talk_status;
+        uniqueServerID_t uniqueServerID;
+        channelID_t channelID;
+        uniqueClientID_t uniqueClientID;
+        bool ownclient;
+    };
+
+    // queues events in order, a drain applies them under one lock and the monitor only sees the state left after it.
+    int process_talk_batch(const talk_event* events, const size_t count);
+    int process_talk_batch(const std::vector<talk_event>& events)
+    {
+        return process_talk_batch(events.data(), events.size());
+    }
+    void flush_talk_events(); // waits until queued talk events reached AudioMonitor, not from m_hold_thread
+
+    struct talk_ingest_stats
+    {
+        uint64_t calls;              // process_talk and process_talk_batch calls
+        uint64_t events;             // talk events queued
+        uint64_t overflows;          // events the caller applied itself (ring full or id too long to queue)
+        uint64_t drains;             // m_hold_thread passes that applied queued events
+        uint64_t monitor_requests;   // AudioMonitor Start/Pause/Stop requests
+        uint64_t monitor_superseded; // requests replaced by a later one before they ran
+        uint64_t dwell_total_ns;     // time callers spent inside the calls
+        uint64_t dwell_max_ns;
+    };
+    talk_ingest_stats get_talk_ingest_stats() const; // thread safe, non blocking
+
+    // immutable and shared, set_settings publishes a new one.
+    typedef std::shared_ptr<const vo::volume_options_settings> settings_snapshot;
+
+    vo::volume_options_settings get_current_settings() const; // a copy of get_settings_snapshot()
+    settings_snapshot get_settings_snapshot() const; // thread safe, non blocking
     void set_settings(vo::volume_options_settings& settings);
     int set_settings_from_file(const std::string &configIniFile, bool create_if_notfound = false);
     void set_config_file(const std::string &configFile);
+    int set_journal_file(const std::string &journalFile);
     void save_settings_to_file(const std::string &configFile) const;
 
     void restore_default_volume();
-    float get_global_volume_reduction() const;
+    float get_global_volume_reduction() const; // thread safe, non blocking
     void reset_data(); /* not used */
 
     void set_status(const status s);
-    status get_status() const;
+    status get_status() const; // thread safe, non blocking
+    talk_hysteresis::stats get_talk_stats() const;
 
-    void set_channel_status(const uniqueServerID_t uniqueServerID, const channelID_t channelID, const status s);
-    status get_channel_status(const uniqueServerID_t uniqueServerID, const channelID_t channelID) const;
+    void set_channel_status(const uniqueServerID_t& uniqueServerID, const channelID_t channelID, const status s);
+    status get_channel_status(const uniqueServerID_t& uniqueServerID, const channelID_t channelID) const;
     void reset_all_channels_settings();
 
-    void set_client_status(const uniqueClientID_t uniqueClientID, const status s);
-    status get_client_status(const uniqueClientID_t uniqueClientID) const;
+    void set_client_status(const uniqueClientID_t& uniqueClientID, const status s);
+    status get_client_status(const uniqueClientID_t& uniqueClientID) const;
     void reset_all_clients_settings();
 
     // returns server uniqueID plus channel ID as a string: "<uniqueServerID_t><space><channelID_t>"
@@ -109,26 +154,94 @@ private:
     inline volume_options_settings ptree_to_settings(boost::property_tree::ptree& pt) const;
     inline boost::property_tree::ptree settings_to_ptree(const volume_options_settings& settings) const;
 
+    void push_talk(const bool talk_status, const uniqueServerID_t& uniqueServerID, const channelID_t channelID,
+        const uniqueClientID_t& uniqueClientID, const bool ownclient);
+    void drain_talk_events();
+    size_t pop_talk_events();
+    void record_talk(const bool talk_status, const uniqueServerID_t& uniqueServerID, const channelID_t channelID,
+        const uniqueClientID_t& uniqueClientID, const bool ownclient);
+    struct channel_activity;
+    void add_channel_talker(const channel_key& channel, const bool enabled_client);
+    void remove_channel_talker(const channel_key& channel, const bool enabled_client);
+    void shift_enabled_talkers(const channel_key& channel, channel_activity& activity, const bool enable);
     int apply_status(); // starts or stops audio monitor based on ts3 talking statuses.
+    int run_talk_action(const talk_hysteresis::action_t action);
+    enum class monitor_request_t { NONE, START, PAUSE, STOP };
+    void request_monitor(const monitor_request_t request);
+    void apply_monitor_request();
+    void arm_hold_timer();
+    void on_hold_timer(const boost::system::error_code& ec);
+    void publish_settings();
 
     std::shared_ptr<AudioMonitor> m_paudio_monitor;
+    std::shared_ptr<volume_journal> m_journal; // default volumes, restores sessions a crash left ducked
 
     vo::volume_options_settings m_vo_settings;
+    settings_snapshot m_settings_snapshot; // m_vo_settings as last published, std::atomic_load/atomic_store only
+
+    /* servers and clients seen, talk state below uses their keys (talk_keys.h) */
+    talk_key_index m_server_keys;
+    talk_key_index m_client_keys;
 
-    /* current disabled and enabled clients talking */
-    std::vector<std::unordered_set<uniqueClientID_t>> m_clients_talking; // 0 = status::DISABLED, 1 = status::ENABLED
+    /* clients currently talking and the channel each one talks from */
+    std::unordered_map<talk_key_t, channel_key> m_talkers;
     /* clients marked as disabled */
-    std::unordered_set<uniqueClientID_t> m_ignored_clients;
+    std::unordered_set<talk_key_t> m_ignored_clients;
 
-    typedef std::unordered_map<uniqueChannelID_t, std::unordered_set<uniqueClientID_t>> channel_info;
-    /* current enabled and disabled channels with activity (someone talking in it) */
-    std::vector<channel_info> m_channels_with_activity; // 0 = status::DISABLED, 1 = status::ENABLED
+    struct channel_activity
+    {
+        channel_activity() : talkers(0), enabled_talkers(0) {}
+
+        uint32_t talkers;         // clients talking in the channel
+        uint32_t enabled_talkers; // the ones not marked as disabled
+    };
+    /* channels with activity (someone talking in it) */
+    std::unordered_map<channel_key, channel_activity, channel_key_hash> m_channels_with_activity;
     /* channels marked as disabled */
-    std::unordered_set<uniqueChannelID_t> m_ignored_channels;
+    std::unordered_set<channel_key, channel_key_hash> m_ignored_channels;
+    /* channels not marked as disabled with enabled talkers, someone enabled is talking while non zero */
+    size_t m_enabled_channels;
 
-    mutable status m_status;
+    mutable std::atomic<status> m_status;
     bool m_someone_enabled_is_talking;
 
+    // Debounces m_someone_enabled_is_talking into AudioMonitor Start/Pause, its deadlines run on m_hold_thread.
+    // m_hold_thread also applies queued talk events and is the only thread calling AudioMonitor Start/Pause/Stop,
+    //  never with m_mutex held.
+    talk_hysteresis m_talk_hold;
+    boost::asio::io_service m_hold_io;
+    std::unique_ptr<boost::asio::io_service::work> m_hold_work;
+    boost::asio::steady_timer m_hold_timer;
+    std::thread m_hold_thread;
+
+    // A talk event waiting for m_hold_thread, unique ids inline so pushing one never allocates.
+    // TS3 unique ids are base64 SHA-1 (28 chars), longer ones are not queued, see push_talk.
+    struct queued_talk
+    {
+        enum { max_id = 63 };
+
+        bool talk_status;
+        bool ownclient;
+        uint8_t server_size;
+        uint8_t client_size;
+        channelID_t channelID;
+        char server[max_id];
+        char client[max_id];
+    };
+    mpsc_ring<queued_talk> m_talk_events;
+    std::string m_queued_server; // pop_talk_events buffers, under m_mutex
+    std::string m_queued_client;
+    std::atomic<bool> m_talk_drain_pending; // a drain_talk_events is posted and has not started yet
+    std::atomic<uint64_t> m_talk_events_pushed;
+    std::atomic<uint64_t> m_talk_overflows;
+    std::atomic<uint64_t> m_talk_drains;
+    detail::sync_call_latency m_talk_dwell; // time spent in process_talk and process_talk_batch
+
+    // Latest AudioMonitor request not yet run by m_hold_thread, last writer wins.
+    std::atomic<monitor_request_t> m_monitor_request;
+    std::atomic<uint64_t> m_monitor_requests;
+    std::atomic<uint64_t> m_monitor_superseded;
+
     std::string m_config_filename;
 
     /* not realy needed, teams speak sdk uses 1 thread per plugin on callbacks */
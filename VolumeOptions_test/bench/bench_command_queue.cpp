@@ -0,0 +1,271 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Callback hand off microbenchmark, io_service::post per callback against the monitor command ring.
+
+    Producer threads play the OS callback threads: each call hands a fixed size command holding a session
+        shared_ptr to a single consumer thread, as CAudioSessionEvents does. The post path binds and posts
+        one handler per command (what ASYNC_CALL did), the ring path pushes into an mpsc_ring and posts a
+        drain only when the ring goes from idle to busy, commands finding it full go to an overflow list the
+        drain runs after the ring (what AudioMonitor::PushCommand does).
+    Reports throughput and the time a callback thread spends per hand off, p50/p99/max.
+
+    Usage: bench_command_queue [--producers N] [--commands N] [--ring N] [--sample N]
+
+        --producers     callback threads                                (default 4)
+        --commands      commands per producer                           (default 250000)
+        --ring          ring capacity                                   (default 1024)
+        --sample        time one hand off every N                       (default 8)
+*/
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../volumeoptions/mpsc_ring.h"
+#include "bench_common.h"
+
+using vo::bench::latency_stats;
+
+namespace {
+
+struct session
+{
+    session() : state(0), volume(0.0f) {}
+    int state;
+    float volume;
+};
+
+struct command
+{
+    command() : kind(0), state(0), volume(0.0f) {}
+
+    int kind;
+    std::shared_ptr<session> target;
+    int state;
+    float volume;
+};
+
+std::atomic<uint64_t> g_handled(0);
+
+void handle(const std::shared_ptr<session>& s, int state)
+{
+    s->state = state;
+    g_handled.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*
+    Same hand off protocol as BasicAudioMonitor::PushCommand/DrainCommands.
+*/
+class ring_path
+{
+public:
+    ring_path(boost::asio::io_service& io, size_t capacity)
+        : m_io(io)
+        , m_ring(capacity)
+        , m_pending(false)
+        , m_overflowed(false)
+        , m_batches(0)
+        , m_overflows(0)
+    {}
+
+    void push(command&& c)
+    {
+        if (!m_overflowed.load() && m_ring.try_push(std::move(c)))
+        {
+            if (!m_pending.exchange(true))
+                m_io.post(std::bind(&ring_path::drain, this));
+            return;
+        }
+
+        m_overflows.fetch_add(1, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(m_overflow_mutex);
+            m_overflow.push_back(std::move(c));
+            m_overflowed.store(true);
+        }
+        if (!m_pending.exchange(true))
+            m_io.post(std::bind(&ring_path::drain, this));
+    }
+
+    uint64_t batches() const { return m_batches; }
+    uint64_t overflows() const { return m_overflows; }
+
+private:
+    void drain()
+    {
+        m_pending.store(false);
+        command c;
+        while (m_ring.try_pop(c))
+            handle(c.target, c.state);
+
+        if (m_overflowed.load())
+        {
+            std::vector<command> commands;
+            {
+                std::lock_guard<std::mutex> lock(m_overflow_mutex);
+                while (m_ring.try_pop(c))
+                    commands.push_back(std::move(c));
+                std::move(m_overflow.begin(), m_overflow.end(), std::back_inserter(commands));
+                m_overflow.clear();
+                m_overflowed.store(false);
+            }
+            for (command& o : commands)
+                handle(o.target, o.state);
+        }
+        m_batches++;
+    }
+
+    boost::asio::io_service& m_io;
+    vo::mpsc_ring<command> m_ring;
+    std::atomic<bool> m_pending;
+    std::atomic<bool> m_overflowed;
+    std::mutex m_overflow_mutex;
+    std::vector<command> m_overflow;
+    uint64_t m_batches; // consumer thread only
+    std::atomic<uint64_t> m_overflows;
+};
+
+struct run_result
+{
+    double seconds;
+    latency_stats handoff;
+};
+
+// f(producer, i, session) hands off one command.
+template <class F>
+run_result run(unsigned producers, unsigned commands, unsigned sample, boost::asio::io_service& io, F f)
+{
+    g_handled = 0;
+    io.reset();
+
+    std::unique_ptr<boost::asio::io_service::work> work(new boost::asio::io_service::work(io));
+    std::thread consumer([&io]() { io.run(); });
+
+    std::vector<std::vector<std::chrono::steady_clock::duration>> samples(producers);
+    std::vector<std::thread> threads;
+    std::atomic<bool> go(false);
+
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p]()
+        {
+            std::shared_ptr<session> s(std::make_shared<session>());
+            samples[p].reserve(commands / sample + 1);
+            while (!go.load())
+                std::this_thread::yield();
+
+            for (unsigned i = 0; i < commands; ++i)
+            {
+                if (i % sample == 0)
+                {
+                    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+                    f(i, s);
+                    samples[p].push_back(std::chrono::steady_clock::now() - t0);
+                }
+                else
+                    f(i, s);
+            }
+        });
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto& t : threads)
+        t.join();
+    const uint64_t total = static_cast<uint64_t>(producers) * commands;
+    while (g_handled.load() < total)
+        std::this_thread::yield();
+
+    run_result r;
+    r.seconds = vo::bench::seconds_since(start);
+
+    work.reset();
+    consumer.join();
+
+    for (auto& v : samples)
+        for (auto d : v)
+            r.handoff.add(d);
+    return r;
+}
+
+void print(const char* name, run_result& r, uint64_t total)
+{
+    printf("  %-18s %10llu cmds %8.3f s %12.0f cmds/s\n", name, (unsigned long long)total, r.seconds,
+        total / r.seconds);
+    r.handoff.print("    hand off");
+}
+
+} // end namespace
+
+int main(int argc, char* argv[])
+{
+    vo::bench::options opt(argc, argv);
+    const unsigned producers = std::max(1u, opt.get<unsigned>("--producers", 4));
+    const unsigned commands = opt.get<unsigned>("--commands", 250000);
+    const unsigned ring = std::max(2u, opt.get<unsigned>("--ring", 1024));
+    const unsigned sample = std::max(1u, opt.get<unsigned>("--sample", 8));
+    const uint64_t total = static_cast<uint64_t>(producers) * commands;
+
+    printf("bench_command_queue: %u producers x %u commands, ring %u\n\n", producers, commands, ring);
+
+    boost::asio::io_service io;
+
+    run_result post = run(producers, commands, sample, io, [&io](unsigned i, const std::shared_ptr<session>& s)
+    {
+        io.post(std::bind(&handle, s, static_cast<int>(i & 1)));
+    });
+
+    ring_path rp(io, ring);
+    run_result pushed = run(producers, commands, sample, io, [&rp](unsigned i, const std::shared_ptr<session>& s)
+    {
+        command c;
+        c.target = s;
+        c.state = static_cast<int>(i & 1);
+        rp.push(std::move(c));
+    });
+
+    printf("throughput:\n");
+    print("io_service::post", post, total);
+    print("mpsc_ring", pushed, total);
+    printf("    drains %llu (%.1f cmds each), overflows %llu\n", (unsigned long long)rp.batches(),
+        rp.batches() ? double(total) / rp.batches() : 0.0, (unsigned long long)rp.overflows());
+
+    printf("\npeak memory: %llu KiB\n", vo::bench::peak_memory_kib());
+    return 0;
+}
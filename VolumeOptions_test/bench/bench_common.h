@@ -0,0 +1,170 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Small helpers shared by the benchmark programs, latency samples, percentiles and peak memory.
+*/
+
+#ifndef VO_BENCH_COMMON_H
+#define VO_BENCH_COMMON_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fstream>
+#endif
+
+namespace vo {
+namespace bench {
+
+/*
+    Latency samples in nanoseconds, not thread safe.
+*/
+class latency_stats
+{
+public:
+    void add(std::chrono::steady_clock::duration d)
+    {
+        m_samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
+    size_t count() const { return m_samples.size(); }
+
+    // p in [0, 1], sorts samples on first use.
+    double percentile_us(double p)
+    {
+        if (m_samples.empty())
+            return 0.0;
+        std::sort(m_samples.begin(), m_samples.end());
+        size_t i = static_cast<size_t>(p * (m_samples.size() - 1) + 0.5);
+        return m_samples[i] / 1000.0;
+    }
+
+    double total_ms() const
+    {
+        double t = 0.0;
+        for (auto s : m_samples)
+            t += s;
+        return t / 1000000.0;
+    }
+
+    void print(const char* name)
+    {
+        if (m_samples.empty())
+        {
+            printf("  %-26s %10s\n", name, "-");
+            return;
+        }
+        printf("  %-26s %10llu  p50 %9.2f us  p99 %9.2f us  max %10.2f us  total %9.2f ms\n", name,
+            (unsigned long long)m_samples.size(), percentile_us(0.50), percentile_us(0.99),
+            percentile_us(1.0), total_ms());
+    }
+
+    void clear() { m_samples.clear(); }
+
+private:
+    std::vector<long long> m_samples;
+};
+
+/*
+    Peak resident memory of this process in KiB, 0 if unknown.
+*/
+inline unsigned long long peak_memory_kib()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+        return pmc.PeakWorkingSetSize / 1024;
+    return 0;
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::strtoull(line.c_str() + 6, nullptr, 10);
+    }
+    return 0;
+#endif
+}
+
+/*
+    Minimal "--name value" command line reader.
+*/
+class options
+{
+public:
+    options(int argc, char* argv[]) : m_argc(argc), m_argv(argv) {}
+
+    template <class T>
+    T get(const char* name, T def) const
+    {
+        for (int i = 1; i + 1 < m_argc; ++i)
+        {
+            if (std::strcmp(m_argv[i], name) == 0)
+                return static_cast<T>(std::strtod(m_argv[i + 1], nullptr));
+        }
+        return def;
+    }
+
+    bool has(const char* name) const
+    {
+        for (int i = 1; i < m_argc; ++i)
+        {
+            if (std::strcmp(m_argv[i], name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    int m_argc;
+    char** m_argv;
+};
+
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // end namespace bench
+} // end namespace vo
+
+#endif
@@ -0,0 +1,239 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Session churn load generator for AudioMonitor.
+
+    Drives the monitor through the simulated backend the same way SndVol does with browsers with many
+        tabs or game launchers: thousands of sessions appear, go active/inactive, change volume, close
+        and expire. Reports throughput per phase, p50/p99 latency of each monitor handler and peak memory.
+
+    Usage: bench_session_churn [--sessions N] [--group N] [--churn N] [--close-pct P] [--volume-pct P]
+                               [--rate OPS_PER_SEC] [--settings N] [--refreshes N] [--filters N] [--seed N]
+
+        --sessions      sessions alive at the start                     (default 5000)
+        --group         sessions per SID (instances of the same app)    (default 8)
+        --churn         churn operations after startup                  (default 100000)
+        --close-pct     % of churn ops that close a session and open a new one (default 10)
+        --volume-pct    % of churn ops that are user volume changes     (default 5)
+        --rate          churn ops per second, 0 = as fast as possible   (default 0)
+        --settings      SetSettings calls, each reapplies to all        (default 50)
+        --refreshes     Refresh calls, each diffs the endpoint sessions against the saved ones (default 20)
+        --filters       extra excluded process names, none matching     (default 0)
+        --seed          random seed                                     (default 1)
+*/
+
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#include "../volumeoptions/audiomonitor_sim.h"
+#include "bench_common.h"
+
+using namespace vo;
+using vo::bench::latency_stats;
+
+namespace {
+
+// SndVol like identifiers, long on purpose, they are what the monitor hashes and compares.
+std::wstring make_sid(unsigned group)
+{
+    return L"{0.0.0.00000000}.{5e7d2a47-8b2b-4c9f-9a4e-3c1d7f0e2b11}|\\Device\\HarddiskVolume2\\Program Files\\"
+        L"Vendor\\app" + std::to_wstring(group) + L".exe%b{00000000-0000-0000-0000-000000000000}";
+}
+
+struct churn_stats
+{
+    latency_stats handlers[static_cast<int>(sim_handler_t::COUNT)];
+};
+
+} // end namespace
+
+int main(int argc, char* argv[])
+{
+    vo::bench::options opt(argc, argv);
+    const unsigned sessions = opt.get<unsigned>("--sessions", 5000);
+    const unsigned group = std::max(1u, opt.get<unsigned>("--group", 8));
+    const unsigned churn = opt.get<unsigned>("--churn", 100000);
+    const unsigned close_pct = opt.get<unsigned>("--close-pct", 10);
+    const unsigned volume_pct = opt.get<unsigned>("--volume-pct", 5);
+    const double rate = opt.get<double>("--rate", 0.0);
+    const unsigned settings_calls = opt.get<unsigned>("--settings", 50);
+    const unsigned refreshes = opt.get<unsigned>("--refreshes", 20);
+    const unsigned filters = opt.get<unsigned>("--filters", 0);
+    const unsigned seed = opt.get<unsigned>("--seed", 1);
+
+    printf("session churn: sessions=%u group=%u churn=%u close=%u%% volume=%u%% rate=%.0f settings=%u refreshes=%u "
+        "filters=%u\n", sessions, group, churn, close_pct, volume_pct, rate, settings_calls, refreshes, filters);
+
+    std::shared_ptr<SimAudioEndpoint> endpoint = SimAudioEndpoint::add_endpoint(L"{bench-churn}", L"Bench");
+
+    // Handler latencies, written only by the monitor thread, read after a sync call.
+    churn_stats stats;
+    endpoint->set_handler_observer([&stats](sim_handler_t h, std::chrono::steady_clock::duration d)
+    {
+        stats.handlers[static_cast<int>(h)].add(d);
+    });
+
+    std::shared_ptr<SimAudioMonitor> monitor = SimAudioMonitor::create(endpoint->id());
+    while (monitor->GetStatus() == SimAudioMonitor::monitor_status_t::INITERROR)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    monitor_settings settings = monitor->GetSettings();
+    settings.ses_global_settings.vol_reduction = 0.5f;
+    settings.ses_global_settings.treat_vol_as_percentage = true;
+    settings.ses_global_settings.change_only_active_sessions = true;
+    settings.ses_global_settings.vol_up_delay = std::chrono::milliseconds(500);
+    settings.exclude_own_process = true;
+    settings.excluded_process.insert(L"app3.exe");
+    settings.excluded_process.insert(L"voicechat.exe");
+    settings.excluded_process.insert(L"spotify.exe");
+    for (unsigned i = 0; i < filters; ++i)
+        settings.excluded_process.insert(L"C:\\Games\\Launcher" + std::to_wstring(i) + L"\\game.exe");
+    monitor->SetSettings(settings);
+    monitor->Start();
+
+    // Start on a running monitor is a sync call that does nothing, it runs on the monitor strand behind every
+    //  handler posted before it (command drains, expiry sweeps), so it is a barrier. GetSettings reads a snapshot.
+    auto barrier = [&monitor]() { monitor->Start(); };
+
+    std::mt19937 rng(seed);
+    std::vector<SimAudioEndpoint::session_ptr> live;
+    live.reserve(sessions);
+    DWORD next_pid = 1000;
+    unsigned next_member = 0;
+    auto open_session = [&]() -> SimAudioEndpoint::session_ptr
+    {
+        unsigned g = next_member++ / group;
+        return endpoint->add_session(next_pid++, make_sid(g), 0.8f, (rng() % 2) == 0);
+    };
+
+    // Phase 1: sessions appear.
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < sessions; ++i)
+        live.push_back(open_session());
+    barrier();
+    double t_open = vo::bench::seconds_since(start);
+
+    // Phase 2: churn, state toggles, user volume changes, closes and re opens.
+    std::uniform_int_distribution<unsigned> pick(0, sessions - 1);
+    std::chrono::steady_clock::duration pace = std::chrono::steady_clock::duration::zero();
+    if (rate > 0.0)
+        pace = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    unsigned closed = 0;
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < churn; ++i)
+    {
+        unsigned idx = pick(rng);
+        unsigned op = rng() % 100;
+        if (op < close_pct)
+        {
+            endpoint->remove_session(live[idx]);
+            live[idx] = open_session();
+            ++closed;
+        }
+        else if (op < close_pct + volume_pct)
+        {
+            endpoint->set_session_volume(live[idx], (rng() % 100) / 100.0f);
+        }
+        else
+        {
+            session_state_t s = live[idx]->state.load();
+            endpoint->set_session_state(live[idx], (s == session_state_t::ACTIVE) ?
+                session_state_t::INACTIVE : session_state_t::ACTIVE);
+        }
+
+        if (pace != std::chrono::steady_clock::duration::zero())
+            std::this_thread::sleep_until(start + pace * (i + 1));
+    }
+    barrier();
+    double t_churn = vo::bench::seconds_since(start);
+
+    // Phase 3: on demand refreshes, notifications missed nothing so only SIIDs are read.
+    latency_stats refresh;
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < refreshes; ++i)
+    {
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        monitor->Refresh();
+        refresh.add(std::chrono::steady_clock::now() - t0);
+    }
+    double t_refresh = vo::bench::seconds_since(start);
+    SimAudioMonitor::refresh_stats rs = monitor->GetRefreshStats();
+
+    // Phase 4: settings changes reapplied to every saved session.
+    latency_stats set_settings;
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < settings_calls; ++i)
+    {
+        settings.ses_global_settings.vol_reduction = (i % 2) ? 0.5f : 0.3f;
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        monitor->SetSettings(settings);
+        set_settings.add(std::chrono::steady_clock::now() - t0);
+    }
+    double t_settings = vo::bench::seconds_since(start);
+
+    // Phase 5: expiry, half of the sessions go inactive and the sweep runs as if they were old.
+    for (unsigned i = 0; i < sessions; i += 2)
+        endpoint->set_session_state(live[i], session_state_t::INACTIVE);
+    barrier();
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i)
+        endpoint->expire_sessions(std::chrono::minutes(10));
+    barrier();
+    double t_expire = vo::bench::seconds_since(start);
+
+    unsigned long long ops_open = sessions, ops_churn = churn;
+    printf("\nthroughput:\n");
+    printf("  open      %10llu ops %8.3f s %12.0f ops/s\n", ops_open, t_open, ops_open / t_open);
+    printf("  churn     %10llu ops %8.3f s %12.0f ops/s  (%u closed/reopened)\n", ops_churn, t_churn,
+        ops_churn / t_churn, closed);
+    printf("  settings  %10u ops %8.3f s %12.0f ops/s\n", settings_calls, t_settings, settings_calls / t_settings);
+    printf("  refresh   %10u ops %8.3f s %12.0f ops/s  (listed=%llu added=%llu vanished=%llu)\n", refreshes,
+        t_refresh, refreshes / t_refresh, (unsigned long long)rs.listed, (unsigned long long)rs.added,
+        (unsigned long long)rs.vanished);
+    printf("  expire    %10d ops %8.3f s\n", 10, t_expire);
+
+    printf("\nhandler latency:\n");
+    stats.handlers[static_cast<int>(sim_handler_t::SAVE_SESSION)].print("SaveSession");
+    stats.handlers[static_cast<int>(sim_handler_t::STATE_CHANGED)].print("state_changed_callback");
+    stats.handlers[static_cast<int>(sim_handler_t::UPDATE_DEFAULT_VOLUME)].print("UpdateDefaultVolume");
+    stats.handlers[static_cast<int>(sim_handler_t::EXPIRE_SESSIONS)].print("DeleteExpiredSessions");
+    set_settings.print("SetSettings (round trip)");
+    refresh.print("Refresh (round trip)");
+
+    endpoint->set_handler_observer(sim_handler_observer());
+    monitor->Stop();
+    monitor.reset();
+
+    printf("\npeak memory: %llu KiB\n", vo::bench::peak_memory_kib());
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Talk event ingestion benchmark, VolumeOptions::process_talk per event against process_talk_batch.
+
+    Replays the bursts TS3 sends when joining a busy channel or when a whole squad keys up at once: every
+        client of the burst starts talking, then all of them stop, spread over a few channels of a few
+        servers, some clients and channels marked as disabled.
+    Both paths queue the events for the VolumeOptions talk thread, which applies whatever it finds queued
+        under one lock and evaluates the monitor transition once per pass, the per event path pays the
+        hand off per event. Reports events per second up to the last one applied, the time the calling
+        (TS3 callback) thread spends per call, how many times the talk status flipped and how many
+        AudioMonitor requests were made and superseded before they ran.
+
+    Usage: bench_talk_batch [--clients N] [--channels N] [--servers N] [--bursts N] [--batch N]
+                            [--disabled-pct P] [--sessions N]
+
+        --clients       clients talking in each burst                   (default 32)
+        --channels      channels per server                             (default 8)
+        --servers       virtual servers                                 (default 2)
+        --bursts        bursts replayed by each path                    (default 5000)
+        --batch         events per process_talk_batch call, 0 = half a burst, the starts
+                        then the stops, so each batch still starts or pauses the monitor (default 0)
+        --disabled-pct  % of clients and of channels marked as disabled (default 10)
+        --sessions      simulated audio sessions ducked by the monitor  (default 16)
+*/
+
+#include <cstdio>
+#include <random>
+#include <thread>
+
+#include "../volumeoptions/vo_ts3plugin.h"
+#include "bench_common.h"
+
+using namespace vo;
+using vo::bench::latency_stats;
+
+namespace {
+
+// TS3 like identifiers, unique ids are base64 sha1 strings.
+std::string make_server(unsigned i)
+{
+    return "Xq3P1pV2bX8Qw+6z0lF4yR1tNc" + std::to_string(i) + "=";
+}
+
+std::string make_client(unsigned i)
+{
+    return "kY7m9fR2sLx0Tq4vB8nW1eP3aZ" + std::to_string(i) + "=";
+}
+
+struct run_result
+{
+    run_result() : seconds(0.0), ducks(0), releases(0), ingest() {}
+
+    double seconds;
+    uint64_t ducks;
+    uint64_t releases;
+    VolumeOptions::talk_ingest_stats ingest;
+    latency_stats calls;
+};
+
+void print_result(const char* name, size_t events, run_result& r)
+{
+    printf("%s: %.1f ms, %.0f events/s, ducks %llu releases %llu\n", name, r.seconds * 1000.0,
+        events / r.seconds, (unsigned long long)r.ducks, (unsigned long long)r.releases);
+    printf("  drains %llu  overflows %llu  monitor requests %llu (superseded %llu)\n",
+        (unsigned long long)r.ingest.drains, (unsigned long long)r.ingest.overflows,
+        (unsigned long long)r.ingest.monitor_requests, (unsigned long long)r.ingest.monitor_superseded);
+    r.calls.print("caller dwell");
+}
+
+} // end namespace
+
+int main(int argc, char* argv[])
+{
+    vo::bench::options opt(argc, argv);
+    const unsigned clients = std::max(1u, opt.get<unsigned>("--clients", 32));
+    const unsigned channels = std::max(1u, opt.get<unsigned>("--channels", 8));
+    const unsigned servers = std::max(1u, opt.get<unsigned>("--servers", 2));
+    const unsigned bursts = opt.get<unsigned>("--bursts", 5000);
+    const unsigned batch = opt.get<unsigned>("--batch", 0);
+    const unsigned disabled_pct = opt.get<unsigned>("--disabled-pct", 10);
+    const unsigned sessions = opt.get<unsigned>("--sessions", 16);
+
+    printf("talk batch: clients=%u channels=%u servers=%u bursts=%u batch=%u disabled=%u%% sessions=%u\n",
+        clients, channels, servers, bursts, batch, disabled_pct, sessions);
+
+    // Something for the monitor to duck, on the endpoint VolumeOptions monitors.
+    std::shared_ptr<SimAudioEndpoint> endpoint = SimAudioEndpoint::get_endpoint();
+    for (unsigned i = 0; i < sessions; ++i)
+    {
+        endpoint->add_session(2000 + i, L"{0.0.0.00000000}.{5e7d2a47-8b2b-4c9f-9a4e-3c1d7f0e2b11}|\\Device\\"
+            L"HarddiskVolume2\\Games\\game" + std::to_wstring(i) + L".exe%b{00000000-0000-0000-0000-000000000000}",
+            0.8f, true);
+    }
+
+    // One burst, all its clients start talking then all of them stop, in the order TS3 reports them.
+    std::mt19937 rng(1);
+    std::vector<VolumeOptions::talk_event> burst;
+    burst.reserve(2 * clients);
+    for (unsigned i = 0; i < clients; ++i)
+    {
+        VolumeOptions::talk_event e;
+        e.talk_status = true;
+        e.uniqueServerID = make_server(rng() % servers);
+        e.channelID = rng() % channels;
+        e.uniqueClientID = make_client(i);
+        e.ownclient = false;
+        burst.push_back(e);
+    }
+    for (unsigned i = 0; i < clients; ++i)
+    {
+        VolumeOptions::talk_event e = burst[i];
+        e.talk_status = false;
+        burst.push_back(e);
+    }
+    std::shuffle(burst.begin(), burst.begin() + clients, rng);
+    std::shuffle(burst.begin() + clients, burst.end(), rng);
+
+    // Same clients and channels disabled on both paths.
+    auto mark_disabled = [&](VolumeOptions& vo)
+    {
+        std::mt19937 rng(2);
+        for (unsigned i = 0; i < clients; ++i)
+        {
+            if ((rng() % 100) < disabled_pct)
+                vo.set_client_status(make_client(i), VolumeOptions::status::DISABLED);
+        }
+        for (unsigned s = 0; s < servers; ++s)
+        {
+            for (unsigned c = 0; c < channels; ++c)
+            {
+                if ((rng() % 100) < disabled_pct)
+                    vo.set_channel_status(make_server(s), c, VolumeOptions::status::DISABLED);
+            }
+        }
+    };
+
+    const size_t events = burst.size() * static_cast<size_t>(bursts);
+    const size_t per_call = (batch == 0) ? clients : std::min<size_t>(batch, burst.size());
+
+    // Per event path.
+    run_result single;
+    {
+        VolumeOptions vo;
+        mark_disabled(vo);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned b = 0; b < bursts; ++b)
+        {
+            for (const VolumeOptions::talk_event& e : burst)
+            {
+                std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+                vo.process_talk(e.talk_status, e.uniqueServerID, e.channelID, e.uniqueClientID, e.ownclient);
+                single.calls.add(std::chrono::steady_clock::now() - t);
+            }
+        }
+        vo.flush_talk_events();
+        single.seconds = vo::bench::seconds_since(start);
+
+        talk_hysteresis::stats stats = vo.get_talk_stats();
+        single.ducks = stats.ducks;
+        single.releases = stats.releases;
+        single.ingest = vo.get_talk_ingest_stats();
+    }
+
+    // Batch path, same events in the same order.
+    run_result batched;
+    {
+        VolumeOptions vo;
+        mark_disabled(vo);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (unsigned b = 0; b < bursts; ++b)
+        {
+            for (size_t i = 0; i < burst.size(); i += per_call)
+            {
+                std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+                vo.process_talk_batch(burst.data() + i, std::min(per_call, burst.size() - i));
+                batched.calls.add(std::chrono::steady_clock::now() - t);
+            }
+        }
+        vo.flush_talk_events();
+        batched.seconds = vo::bench::seconds_since(start);
+
+        talk_hysteresis::stats stats = vo.get_talk_stats();
+        batched.ducks = stats.ducks;
+        batched.releases = stats.releases;
+        batched.ingest = vo.get_talk_ingest_stats();
+    }
+
+    printf("\n%llu events, %llu per batch\n\n", (unsigned long long)events, (unsigned long long)per_call);
+    print_result("process_talk", events, single);
+    print_result("process_talk_batch", events, batched);
+    printf("\nspeedup %.2fx\n", single.seconds / batched.seconds);
+    printf("peak memory %llu KiB\n", vo::bench::peak_memory_kib());
+
+    return 0;
+}
@@ -0,0 +1,513 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    In memory session backend of BasicAudioMonitor, see audiomonitor_sim.h
+*/
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+#ifndef _WIN32
+#include <unistd.h> // getpid
+#endif
+
+#include "../volumeoptions/config.h"
+#include "../volumeoptions/audiomonitor_sim.h"
+#include "../volumeoptions/audiomonitor_impl.hpp"
+
+namespace vo {
+
+/*
+    C++ idiom : Friendship and the Attorney-Client
+    Same role as AudioCallbackProxy, simulated "OS callbacks" use it to post into the monitor.
+*/
+class SimCallbackProxy
+{
+private:
+    typedef std::shared_ptr<const sim_handler_observer> observer_ptr;
+
+    static void report(const observer_ptr& observer, sim_handler_t h, std::chrono::steady_clock::time_point start)
+    {
+        if (observer)
+            (*observer)(h, std::chrono::steady_clock::now() - start);
+    }
+
+    static void SaveSession(const std::shared_ptr<SimAudioMonitor>& pam, SimSessionBackend::session_source s)
+    {
+        pam->PushCommand(SimAudioMonitor::monitor_command::session_created(std::move(s)));
+    }
+    static void state_changed_callback_handler(const std::shared_ptr<SimAudioMonitor>& pam,
+        std::shared_ptr<SimAudioSession> pas, session_state_t newstatus)
+    {
+        pam->PushCommand(SimAudioMonitor::monitor_command::state_changed(std::move(pas), newstatus));
+    }
+    static void UpdateDefaultVolume(const std::shared_ptr<SimAudioMonitor>& pam, std::shared_ptr<SimAudioSession> pas,
+        float new_def)
+    {
+        pam->PushVolumeChange(std::move(pas), new_def);
+    }
+    static void ExpireSessions(const std::shared_ptr<SimAudioMonitor>& pam, std::chrono::steady_clock::duration time_skew,
+        observer_ptr observer)
+    {
+        SimAudioMonitor* monitor = pam.get(); // the handler must not own the monitor, see ~BasicAudioMonitor
+        pam->Post([monitor, time_skew, observer]()
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            monitor->ExpireSessions(start + time_skew);
+            report(observer, sim_handler_t::EXPIRE_SESSIONS, start);
+        });
+    }
+
+    friend class SimAudioEndpoint;
+};
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    //////////////////////////////////  Simulated Endpoints  ////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+    const wchar_t* const sim_default_endpoint_id = L"{0.0.0.00000000}.{sim-default}";
+}
+
+std::mutex SimAudioEndpoint::m_registry_mutex;
+std::map<std::wstring, std::shared_ptr<SimAudioEndpoint>> SimAudioEndpoint::m_registry;
+std::wstring SimAudioEndpoint::m_default_id(sim_default_endpoint_id);
+std::map<uint64_t, endpoint_listener> SimAudioEndpoint::m_watchers;
+uint64_t SimAudioEndpoint::m_next_watcher = 1;
+
+SimAudioEndpoint::SimAudioEndpoint(const std::wstring& id, const std::wstring& name)
+    : m_id(id)
+    , m_name(name)
+    , m_next_instance(0)
+{}
+
+std::shared_ptr<SimAudioEndpoint> SimAudioEndpoint::add_endpoint(const std::wstring& id, const std::wstring& name)
+{
+    std::shared_ptr<SimAudioEndpoint> ep;
+    bool added = false;
+    {
+        std::lock_guard<std::mutex> l(m_registry_mutex);
+
+        std::shared_ptr<SimAudioEndpoint>& slot = m_registry[id];
+        if (!slot)
+        {
+            slot = std::make_shared<SimAudioEndpoint>(id, name);
+            added = true;
+        }
+        ep = slot;
+    }
+
+    if (added)
+        notify(endpoint_event_t::ADDED, id);
+
+    return ep;
+}
+
+/*
+    The device was unplugged, its sessions stay with whoever holds them but the endpoint is gone.
+*/
+void SimAudioEndpoint::remove_endpoint(const std::wstring& id)
+{
+    bool was_default = false;
+    {
+        std::lock_guard<std::mutex> l(m_registry_mutex);
+
+        if (!m_registry.erase(id))
+            return;
+        if (id == m_default_id)
+        {
+            m_default_id = sim_default_endpoint_id;
+            was_default = true;
+        }
+    }
+
+    if (was_default)
+    {
+        get_endpoint(); // make sure the fallback exists
+        notify(endpoint_event_t::DEFAULT_CHANGED, sim_default_endpoint_id);
+    }
+    notify(endpoint_event_t::REMOVED, id);
+}
+
+/*
+    Empty id returns the default endpoint, the simulated speakers are created on first use.
+*/
+std::shared_ptr<SimAudioEndpoint> SimAudioEndpoint::get_endpoint(const std::wstring& id)
+{
+    {
+        std::lock_guard<std::mutex> l(m_registry_mutex);
+
+        auto it = m_registry.find(id.empty() ? m_default_id : id);
+        if (it != m_registry.end())
+            return it->second;
+        if (!id.empty())
+            return nullptr;
+    }
+
+    return add_endpoint(sim_default_endpoint_id, L"Simulated Speakers");
+}
+
+bool SimAudioEndpoint::set_default_endpoint(const std::wstring& id)
+{
+    {
+        std::lock_guard<std::mutex> l(m_registry_mutex);
+
+        if (!m_registry.count(id))
+            return false;
+        if (id == m_default_id)
+            return true;
+        m_default_id = id;
+    }
+
+    notify(endpoint_event_t::DEFAULT_CHANGED, id);
+
+    return true;
+}
+
+std::wstring SimAudioEndpoint::default_endpoint_id()
+{
+    std::lock_guard<std::mutex> l(m_registry_mutex);
+
+    return m_default_id;
+}
+
+/*
+    Calls the endpoint watchers outside the registry lock, they may query it.
+*/
+void SimAudioEndpoint::notify(endpoint_event_t e, const std::wstring& id)
+{
+    std::vector<endpoint_listener> watchers;
+    {
+        std::lock_guard<std::mutex> l(m_registry_mutex);
+
+        for (auto& w : m_watchers)
+            watchers.push_back(w.second);
+    }
+
+    for (auto& f : watchers)
+        f(e, id);
+}
+
+std::vector<std::shared_ptr<SimAudioEndpoint>> SimAudioEndpoint::endpoints()
+{
+    std::lock_guard<std::mutex> l(m_registry_mutex);
+
+    std::vector<std::shared_ptr<SimAudioEndpoint>> ret;
+    for (auto& e : m_registry)
+        ret.push_back(e.second);
+
+    return ret;
+}
+
+/*
+    A process opened a new audio stream.
+
+    SIIDs are generated like SndVol does, SID plus a per instance suffix.
+    If a monitor listens for new sessions it receives the session as IAudioSessionNotification would.
+*/
+SimAudioEndpoint::session_ptr SimAudioEndpoint::add_session(DWORD pid, const std::wstring& sid, float volume,
+    bool active, bool system_sounds)
+{
+    session_ptr s;
+    std::shared_ptr<SimAudioMonitor> spAudioMonitor;
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+
+        std::wstring siid = sid + L"%b{sim-" + std::to_wstring(m_next_instance++) + L"}";
+        s = std::make_shared<SimAudioSessionControl>(pid, sid, siid, volume,
+            active ? session_state_t::ACTIVE : session_state_t::INACTIVE, system_sounds);
+        m_sessions.push_back(s);
+
+        spAudioMonitor = m_notifications.lock();
+    }
+
+    if (spAudioMonitor)
+        SimCallbackProxy::SaveSession(spAudioMonitor, s);
+
+    return s;
+}
+
+void SimAudioEndpoint::set_session_state(const session_ptr& s, session_state_t state)
+{
+    if (s->state.exchange(state) == state)
+        return;
+
+    std::shared_ptr<SimAudioSession> spAudioSession;
+    std::shared_ptr<SimAudioMonitor> spAudioMonitor;
+    {
+        std::lock_guard<std::mutex> l(s->events_mutex);
+        spAudioSession = s->events_session.lock();
+        spAudioMonitor = s->events_monitor.lock();
+    }
+
+    // As WASAPI, expired sessions are not reported.
+    if (spAudioSession && spAudioMonitor && (state != session_state_t::EXPIRED))
+        SimCallbackProxy::state_changed_callback_handler(spAudioMonitor, std::move(spAudioSession), state);
+}
+
+/*
+    Volume changed by someone else than the monitor, the monitor takes it as the new user default.
+*/
+void SimAudioEndpoint::set_session_volume(const session_ptr& s, float volume)
+{
+    s->volume.store(volume);
+
+    std::shared_ptr<SimAudioSession> spAudioSession;
+    std::shared_ptr<SimAudioMonitor> spAudioMonitor;
+    {
+        std::lock_guard<std::mutex> l(s->events_mutex);
+        spAudioSession = s->events_session.lock();
+        spAudioMonitor = s->events_monitor.lock();
+    }
+
+    if (spAudioSession && spAudioMonitor)
+        SimCallbackProxy::UpdateDefaultVolume(spAudioMonitor, std::move(spAudioSession), volume);
+}
+
+/*
+    The process closed its stream, the session goes inactive and leaves the enumerator.
+*/
+void SimAudioEndpoint::remove_session(const session_ptr& s)
+{
+    set_session_state(s, session_state_t::INACTIVE);
+
+    std::lock_guard<std::mutex> l(m_mutex);
+    m_sessions.erase(std::remove(m_sessions.begin(), m_sessions.end(), s), m_sessions.end());
+}
+
+std::vector<SimAudioEndpoint::session_ptr> SimAudioEndpoint::get_sessions() const
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    return m_sessions;
+}
+
+/*
+    Same as the monitor expiry timer firing, 'time_skew' lets tests expire sessions without waiting.
+*/
+void SimAudioEndpoint::expire_sessions(std::chrono::steady_clock::duration time_skew)
+{
+    std::shared_ptr<SimAudioMonitor> spAudioMonitor;
+    std::shared_ptr<const sim_handler_observer> observer;
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+        spAudioMonitor = m_notifications.lock();
+        observer = m_observer;
+    }
+
+    if (spAudioMonitor)
+        SimCallbackProxy::ExpireSessions(spAudioMonitor, time_skew, observer);
+}
+
+void SimAudioEndpoint::set_handler_observer(const sim_handler_observer& observer)
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    if (observer)
+        m_observer = std::make_shared<const sim_handler_observer>(observer);
+    else
+        m_observer.reset();
+}
+
+std::shared_ptr<const sim_handler_observer> SimAudioEndpoint::get_observer() const
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    return m_observer;
+}
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    //////////////////////////////////  Simulated Session Backend  //////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+DWORD SimSessionBackend::current_process_id()
+{
+#ifdef _WIN32
+    return GetCurrentProcessId();
+#else
+    return static_cast<DWORD>(getpid());
+#endif
+}
+
+HRESULT SimSessionBackend::get_endpoints_info(std::map<std::wstring, std::wstring>& audio_endpoints,
+    DWORD /*dwStateMask*/)
+{
+    audio_endpoints.clear();
+
+    SimAudioEndpoint::get_endpoint(); // there is always a default endpoint
+    for (auto& e : SimAudioEndpoint::endpoints())
+        audio_endpoints[e->id()] = e->name();
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::open_manager(manager_handle& m, std::wstring& device_id)
+{
+    m.endpoint = SimAudioEndpoint::get_endpoint(device_id);
+    if (!m.endpoint)
+        return E_NOTFOUND;
+
+    device_id = m.endpoint->id();
+
+    return S_OK;
+}
+
+void SimSessionBackend::close_manager(manager_handle& m)
+{
+    unregister_notifications(m);
+    m.endpoint.reset();
+}
+
+HRESULT SimSessionBackend::register_notifications(manager_handle& m, const std::weak_ptr<monitor_type>& wpAudioMonitor)
+{
+    if (!m.endpoint)
+        return E_POINTER;
+    if (m.notifications)
+        return S_FALSE;
+
+    std::lock_guard<std::mutex> l(m.endpoint->m_mutex);
+    m.endpoint->m_notifications = wpAudioMonitor;
+    m.notifications = true;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::unregister_notifications(manager_handle& m)
+{
+    if (!m.endpoint || !m.notifications)
+        return S_FALSE;
+
+    std::lock_guard<std::mutex> l(m.endpoint->m_mutex);
+    m.endpoint->m_notifications.reset();
+    m.notifications = false;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::enumerate_sessions(manager_handle& m, const std::function<void(session_source)>& f)
+{
+    if (!m.endpoint)
+        return E_POINTER;
+
+    for (auto& s : m.endpoint->get_sessions())
+        f(s);
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::get_session_info(const session_source& s, session_info& info)
+{
+    if (!s)
+        return E_POINTER;
+
+    info.pid = s->pid;
+    info.sid = s->sid;
+    info.siid = s->siid;
+    info.system_sounds = s->system_sounds;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::get_session_instance_id(const session_source& s, std::wstring& siid)
+{
+    if (!s)
+        return E_POINTER;
+
+    siid = s->siid;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::open_session(session_handle& h, const session_source& s)
+{
+    if (!s)
+        return E_POINTER;
+
+    h.control = s;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::register_session_events(session_handle& h,
+    const std::weak_ptr<session_type>& wpAudioSession, const std::weak_ptr<monitor_type>& wpAudioMonitor)
+{
+    if (h.events)
+        return S_FALSE;
+
+    std::lock_guard<std::mutex> l(h.control->events_mutex);
+    h.control->events_session = wpAudioSession;
+    h.control->events_monitor = wpAudioMonitor;
+    h.events = true;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::unregister_session_events(session_handle& h)
+{
+    if (!h.control || !h.events)
+        return S_FALSE;
+
+    std::lock_guard<std::mutex> l(h.control->events_mutex);
+    h.control->events_session.reset();
+    h.control->events_monitor.reset();
+    h.events = false;
+
+    return S_OK;
+}
+
+HRESULT SimSessionBackend::watch_endpoints(endpoint_watch& w, const endpoint_listener& f)
+{
+    if (w.watcher)
+        return S_FALSE;
+
+    std::lock_guard<std::mutex> l(SimAudioEndpoint::m_registry_mutex);
+    w.watcher = SimAudioEndpoint::m_next_watcher++;
+    SimAudioEndpoint::m_watchers[w.watcher] = f;
+
+    return S_OK;
+}
+
+void SimSessionBackend::unwatch_endpoints(endpoint_watch& w)
+{
+    if (!w.watcher)
+        return;
+
+    std::lock_guard<std::mutex> l(SimAudioEndpoint::m_registry_mutex);
+    SimAudioEndpoint::m_watchers.erase(w.watcher);
+    w.watcher = 0;
+}
+
+// Compile the core for this backend once, here, so backend calls inline into it.
+template class BasicAudioSession<SimSessionBackend>;
+template class BasicAudioMonitor<SimSessionBackend>;
+
+} // end namespace vo
@@ -0,0 +1,188 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Compiled per application session settings, see session_profiles.h
+*/
+
+#include <algorithm>
+#include <set>
+
+#include "../volumeoptions/session_profiles.h"
+#include "../volumeoptions/string_pool.h"
+
+namespace vo {
+
+profile_table::profile_table()
+{}
+
+profile_table::profile_table(const std::map<std::wstring, session_settings>& profiles)
+{
+    // Names are matched case folded, the first spelling of a name wins.
+    std::set<std::wstring> names;
+    for (const auto& p : profiles)
+    {
+        std::wstring name(fold_case(p.first));
+        if (name.empty() || !names.insert(name).second)
+            continue;
+        m_names.push_back(name);
+        m_settings.push_back(p.second);
+    }
+    if (m_names.empty())
+        return;
+
+    const uint32_t n = static_cast<uint32_t>(m_names.size());
+    std::vector<std::vector<uint32_t>> buckets(n);
+    for (uint32_t i = 0; i < n; ++i)
+        buckets[hash(m_names[i], 0) % n].push_back(i);
+
+    // Largest buckets first, they are the hard ones to fit while the table is still empty.
+    std::vector<uint32_t> order(n);
+    for (uint32_t b = 0; b < n; ++b)
+        order[b] = b;
+    std::stable_sort(order.begin(), order.end(),
+        [&buckets](uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    // A few spare slots keep the seed search of the last buckets short, a failed one widens the table.
+    for (uint32_t slots = n + n / 8 + 1;; ++slots)
+    {
+        m_seeds.assign(n, 0);
+        m_slots.assign(slots, no_profile);
+
+        bool placed = true;
+        std::vector<uint32_t> taken;
+        for (uint32_t b : order)
+        {
+            if (buckets[b].empty())
+                break;
+
+            uint32_t seed = 1;
+            for (; seed < 0x100000; ++seed)
+            {
+                taken.clear();
+                for (uint32_t i : buckets[b])
+                {
+                    uint32_t s = hash(m_names[i], seed) % slots;
+                    if ((m_slots[s] != no_profile) || (std::find(taken.begin(), taken.end(), s) != taken.end()))
+                        break;
+                    taken.push_back(s);
+                }
+                if (taken.size() == buckets[b].size())
+                    break;
+            }
+            if (seed == 0x100000)
+            {
+                placed = false;
+                break;
+            }
+
+            m_seeds[b] = seed;
+            for (size_t k = 0; k < taken.size(); ++k)
+                m_slots[taken[k]] = buckets[b][k];
+        }
+
+        if (placed)
+            break;
+    }
+}
+
+uint32_t profile_table::hash(const std::wstring& s, uint32_t seed)
+{
+    // FNV-1a over the UTF-16/32 units, finished with a murmur3 mix so the seed reaches every bit.
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (wchar_t c : s)
+    {
+        h ^= static_cast<uint32_t>(c);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t profile_table::find(const std::wstring& name) const
+{
+    if (m_names.empty())
+        return no_profile;
+
+    const uint32_t seed = m_seeds[hash(name, 0) % m_seeds.size()];
+    if (seed == 0)
+        return no_profile;
+
+    const uint32_t profile = m_slots[hash(name, seed) % m_slots.size()];
+    return ((profile != no_profile) && (m_names[profile] == name)) ? profile : no_profile;
+}
+
+std::wstring profile_table::process_name(const std::wstring& lower_sid)
+{
+    // {endpoint}|\device\harddiskvolume1\path\app.exe%b{instance}
+    size_t begin = lower_sid.find(L'|');
+    begin = (begin == std::wstring::npos) ? 0 : begin + 1;
+    size_t end = lower_sid.find(L"%b", begin);
+    if (end == std::wstring::npos)
+        end = lower_sid.size();
+    if (end <= begin)
+        return std::wstring();
+
+    const size_t sep = lower_sid.find_last_of(L"\\/", end - 1);
+    if ((sep != std::wstring::npos) && (sep >= begin))
+        begin = sep + 1;
+
+    return lower_sid.substr(begin, end - begin);
+}
+
+bool profile_table::same_profiles(const std::map<std::wstring, session_settings>& a,
+    const std::map<std::wstring, session_settings>& b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib)
+    {
+        const session_settings& sa = ia->second;
+        const session_settings& sb = ib->second;
+        if ((ia->first != ib->first) ||
+            (sa.change_only_active_sessions != sb.change_only_active_sessions) ||
+            (sa.treat_vol_as_percentage != sb.treat_vol_as_percentage) ||
+            (sa.vol_reduction != sb.vol_reduction) ||
+            (sa.vol_up_delay != sb.vol_up_delay) ||
+            (sa.vol_attack != sb.vol_attack) ||
+            (sa.vol_release != sb.vol_release) ||
+            (sa.ramp_curve != sb.ramp_curve))
+            return false;
+    }
+
+    return true;
+}
+
+} // end namespace vo
@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    String interning pool, see string_pool.h
+*/
+
+#include <cwctype>
+
+#include "../volumeoptions/string_pool.h"
+
+namespace vo {
+
+namespace {
+const std::wstring g_empty_string;
+}
+
+const std::wstring& interned_wstring::empty_string()
+{
+    return g_empty_string;
+}
+
+std::wstring fold_case(const std::wstring& s)
+{
+    std::wstring r(s.size(), L'\0');
+    for (size_t i = 0; i < s.size(); ++i)
+        r[i] = static_cast<wchar_t>(std::towlower(s[i]));
+    return r;
+}
+
+string_pool& string_pool::global()
+{
+    // created during static initialization, before any thread can race on it.
+    static string_pool* const pool = new string_pool;
+    return *pool;
+}
+
+namespace {
+// forces global() construction at load time, function local statics are not thread safe on VS2013.
+string_pool& g_init_global_pool = string_pool::global();
+}
+
+interned_wstring string_pool::intern(const std::wstring& s)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto it = m_index.find(&s);
+    if (it != m_index.end())
+    {
+        // entries in the index always have a reference, release_last erases them under this lock.
+        it->second->refs.fetch_add(1, std::memory_order_relaxed);
+        return interned_wstring(it->second);
+    }
+
+    string_id_t id;
+    if (!m_free.empty())
+    {
+        id = m_free.back();
+        m_free.pop_back();
+    }
+    else
+    {
+        id = static_cast<string_id_t>(m_entries.size());
+        m_entries.emplace_back();
+    }
+
+    std::unique_ptr<detail::pooled_wstring> e(new detail::pooled_wstring);
+    e->str = s;
+    e->lower = fold_case(s);
+    e->id = id;
+    e->refs.store(1, std::memory_order_relaxed);
+    e->pool = this;
+
+    detail::pooled_wstring* p = e.get();
+    m_entries[id] = std::move(e);
+    m_index.emplace(&p->str, p);
+
+    return interned_wstring(p);
+}
+
+interned_wstring string_pool::find(const std::wstring& s) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto it = m_index.find(&s);
+    if (it == m_index.end())
+        return interned_wstring();
+
+    it->second->refs.fetch_add(1, std::memory_order_relaxed);
+    return interned_wstring(it->second);
+}
+
+size_t string_pool::size() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_index.size();
+}
+
+void string_pool::release_last(detail::pooled_wstring* e)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    // intern() may have revived it while we waited for the lock.
+    if (e->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    string_id_t id = e->id;
+    m_index.erase(&e->str);
+    m_entries[id].reset();
+    m_free.push_back(id);
+}
+
+} // end namespace vo
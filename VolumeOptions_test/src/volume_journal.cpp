@@ -0,0 +1,513 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Crash safe journal of user default volumes, see volume_journal.h
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../volumeoptions/volume_journal.h"
+
+namespace vo {
+
+namespace {
+
+const uint32_t journal_magic = 0x314A4F56; // "VOJ1"
+const uint32_t journal_version = 1;
+
+struct file_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t wchar_size; // the journal never leaves the machine, SIDs are stored as native wchar_t
+    uint32_t reserved;
+};
+
+struct record_header
+{
+    uint32_t size;      // whole record, written last, 0 = end of journal
+    uint32_t checksum;  // FNV-1a of the record after this field
+    float default_volume;
+    uint32_t flags;
+    uint32_t sid_chars;
+};
+
+const uint32_t record_ducked = 1;
+
+size_t record_size(const std::wstring& sid)
+{
+    return (sizeof(record_header) + sid.size() * sizeof(wchar_t) + 3) & ~size_t(3);
+}
+
+uint32_t checksum(const uint8_t* p, size_t n)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; ++i)
+        h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+// p must have record_size(sid) bytes
+void encode(uint8_t* p, const std::wstring& sid, float default_volume, bool ducked)
+{
+    const size_t size = record_size(sid);
+    record_header h;
+    h.size = 0;
+    h.checksum = 0;
+    h.default_volume = default_volume;
+    h.flags = ducked ? record_ducked : 0;
+    h.sid_chars = static_cast<uint32_t>(sid.size());
+
+    std::memcpy(p, &h, sizeof(h));
+    std::memcpy(p + sizeof(h), sid.data(), sid.size() * sizeof(wchar_t));
+    std::memset(p + sizeof(h) + sid.size() * sizeof(wchar_t), 0, size - sizeof(h) - sid.size() * sizeof(wchar_t));
+
+    h.checksum = checksum(p + 2 * sizeof(uint32_t), size - 2 * sizeof(uint32_t));
+    std::memcpy(p + sizeof(uint32_t), &h.checksum, sizeof(uint32_t));
+    // size last, a record cut short by a crash reads as the end of the journal.
+    h.size = static_cast<uint32_t>(size);
+    std::memcpy(p, &h.size, sizeof(uint32_t));
+}
+
+size_t round_size(size_t bytes, size_t granularity)
+{
+    return ((bytes + granularity - 1) / granularity) * granularity;
+}
+
+} // end namespace
+
+/*
+    A read/write shared mapping of the whole file.
+*/
+struct volume_journal::mapping
+{
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE map;
+#else
+    int fd;
+#endif
+    uint8_t* data;
+    size_t size;
+
+    // null if the file can not be opened or mapped, 'truncate' empties it first.
+    static mapping* open(const std::string& path, size_t size, bool truncate)
+    {
+        mapping* m = new mapping;
+        m->data = nullptr;
+        m->size = 0;
+#ifdef _WIN32
+        m->map = NULL;
+        // share delete so compact() can rename over it
+        m->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m->file == INVALID_HANDLE_VALUE)
+        {
+            delete m;
+            return nullptr;
+        }
+        LARGE_INTEGER current;
+        if (GetFileSizeEx(m->file, &current) && (static_cast<size_t>(current.QuadPart) > size))
+            size = static_cast<size_t>(current.QuadPart);
+#else
+        m->fd = ::open(path.c_str(), O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0600);
+        if (m->fd < 0)
+        {
+            delete m;
+            return nullptr;
+        }
+        struct stat st;
+        if ((fstat(m->fd, &st) == 0) && (static_cast<size_t>(st.st_size) > size))
+            size = static_cast<size_t>(st.st_size);
+#endif
+        if (!m->map_view(size))
+        {
+            m->close();
+            delete m;
+            return nullptr;
+        }
+        return m;
+    }
+
+    // grows the file to 'size' (new bytes read as zero) and maps it again.
+    bool map_view(size_t size)
+    {
+        unmap_view();
+#ifdef _WIN32
+        const ULONGLONG s = size;
+        map = CreateFileMappingA(file, NULL, PAGE_READWRITE, static_cast<DWORD>(s >> 32), static_cast<DWORD>(s), NULL);
+        if (map == NULL)
+            return false;
+        data = static_cast<uint8_t*>(MapViewOfFile(map, FILE_MAP_ALL_ACCESS, 0, 0, size));
+        if (data == NULL)
+            return false;
+#else
+        struct stat st;
+        if ((fstat(fd, &st) != 0) || ((static_cast<size_t>(st.st_size) < size) && (ftruncate(fd, size) != 0)))
+            return false;
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (p == MAP_FAILED)
+            return false;
+        data = static_cast<uint8_t*>(p);
+#endif
+        this->size = size;
+        return true;
+    }
+
+    void unmap_view()
+    {
+#ifdef _WIN32
+        if (data)
+            UnmapViewOfFile(data);
+        if (map != NULL)
+            CloseHandle(map);
+        map = NULL;
+#else
+        if (data)
+            munmap(data, size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    // no flush, the OS writes the pages back on its own.
+    void close()
+    {
+        unmap_view();
+#ifdef _WIN32
+        CloseHandle(file);
+#else
+        ::close(fd);
+#endif
+    }
+};
+
+volume_journal::volume_journal()
+    : m_map(nullptr)
+    , m_tail(0)
+    , m_live_bytes(sizeof(file_header))
+    , m_compacting(false)
+    , m_compaction_due(false)
+    , m_records(0)
+    , m_compactions(0)
+{}
+
+volume_journal::~volume_journal()
+{
+    if (m_map)
+    {
+        m_map->close();
+        delete m_map;
+    }
+}
+
+bool volume_journal::open(const std::string& path)
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    if (m_map)
+        return false;
+
+    m_map = mapping::open(path, min_size, false);
+    if (!m_map)
+    {
+        printf("volume_journal::open: Error mapping %s\n", path.c_str());
+        return false;
+    }
+    m_path = path;
+
+    replay();
+
+    return true;
+}
+
+bool volume_journal::is_open() const
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    return m_map != nullptr;
+}
+
+/*
+    Loads the last record of every SID, SIDs left ducked are stranded.
+    A journal of another version or platform is started over.
+*/
+void volume_journal::replay()
+{
+    file_header fh;
+    std::memcpy(&fh, m_map->data, sizeof(fh));
+    if ((fh.magic != journal_magic) || (fh.version != journal_version) || (fh.wchar_size != sizeof(wchar_t)))
+    {
+        if (fh.magic != 0)
+            printf("volume_journal::replay: Unknown journal format, starting over\n");
+        fh.magic = journal_magic;
+        fh.version = journal_version;
+        fh.wchar_size = sizeof(wchar_t);
+        fh.reserved = 0;
+        std::memset(m_map->data, 0, m_map->size);
+        std::memcpy(m_map->data, &fh, sizeof(fh));
+    }
+
+    size_t pos = sizeof(file_header);
+    while (pos + sizeof(record_header) <= m_map->size)
+    {
+        const uint8_t* p = m_map->data + pos;
+        record_header h;
+        std::memcpy(&h, p, sizeof(h));
+        if ((h.size < sizeof(record_header)) || (h.size > m_map->size - pos) ||
+            (sizeof(record_header) + static_cast<size_t>(h.sid_chars) * sizeof(wchar_t) > h.size) ||
+            (checksum(p + 2 * sizeof(uint32_t), h.size - 2 * sizeof(uint32_t)) != h.checksum))
+            break;
+
+        std::wstring sid(h.sid_chars, L'\0');
+        std::memcpy(&sid[0], p + sizeof(record_header), h.sid_chars * sizeof(wchar_t));
+
+        interned_wstring isid = string_pool::global().intern(sid);
+        auto r = m_state.insert(std::make_pair(isid, sid_state()));
+        if (r.second)
+            m_live_bytes += record_size(sid);
+        sid_state& s = r.first->second;
+        s.default_volume = h.default_volume;
+        s.ducked = 0;
+        s.stranded = (h.flags & record_ducked) != 0;
+        s.recorded = false;
+        s.dirty = false;
+
+        pos += h.size;
+    }
+
+    // whatever follows a torn record must not pass for a record later.
+    std::memset(m_map->data + pos, 0, m_map->size - pos);
+    m_tail = pos;
+}
+
+bool volume_journal::reserve(size_t bytes)
+{
+    if (m_tail + bytes <= m_map->size)
+        return true;
+
+    const size_t size = round_size((std::max)(m_map->size * 2, m_tail + bytes), min_size);
+    if (!m_map->map_view(size))
+    {
+        printf("volume_journal::reserve: Error growing %s\n", m_path.c_str());
+        m_map->close();
+        delete m_map;
+        m_map = nullptr; // memory only from now on
+        return false;
+    }
+    return true;
+}
+
+bool volume_journal::append(const std::wstring& sid, const sid_state& s)
+{
+    const size_t size = record_size(sid);
+    if (!reserve(size))
+        return false;
+
+    encode(m_map->data + m_tail, sid, s.default_volume, (s.ducked > 0) || s.stranded);
+    m_tail += size;
+    m_records++;
+
+    return true;
+}
+
+bool volume_journal::record(const interned_wstring& sid, float default_volume, int ducked_delta)
+{
+    if (sid.empty())
+        return false;
+
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    auto r = m_state.insert(std::make_pair(sid, sid_state())); // zeroed
+    sid_state& s = r.first->second;
+    if (r.second)
+        m_live_bytes += record_size(sid.str());
+
+    const bool was_ducked = (s.ducked > 0) || s.stranded; // as the journal has it
+    const bool changed = r.second || (s.default_volume != default_volume);
+
+    if (ducked_delta > 0)
+        s.ducked++;
+    else if ((ducked_delta < 0) && (s.ducked > 0))
+        s.ducked--;
+    s.default_volume = default_volume;
+    s.stranded = false;
+    s.recorded = true;
+
+    if (!(changed || (was_ducked != (s.ducked > 0))) || !m_map)
+        return false;
+
+    if (m_compacting)
+        s.dirty = true;
+    append(sid.str(), s);
+
+    if (m_map && !m_compacting && !m_compaction_due && (m_tail > min_size) && (m_tail > compact_ratio * m_live_bytes))
+    {
+        m_compaction_due = true;
+        return true;
+    }
+    return false;
+}
+
+bool volume_journal::default_volume(const interned_wstring& sid, float& volume) const
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    auto it = m_state.find(sid);
+    if ((it == m_state.end()) || !(it->second.stranded || it->second.recorded))
+        return false;
+
+    volume = it->second.default_volume;
+    return true;
+}
+
+/*
+    The snapshot is written to a new file without the lock, only the records made meanwhile and the
+        switch to the new file hold it.
+*/
+bool volume_journal::compact()
+{
+    std::vector<uint8_t> image;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> l(m_mutex);
+
+        m_compaction_due = false;
+        if (!m_map || m_compacting)
+            return false;
+        m_compacting = true;
+        path = m_path;
+
+        image.resize(m_live_bytes);
+        file_header fh = { journal_magic, journal_version, sizeof(wchar_t), 0 };
+        std::memcpy(&image[0], &fh, sizeof(fh));
+        size_t pos = sizeof(fh);
+        for (auto& e : m_state)
+        {
+            e.second.dirty = false;
+            encode(&image[pos], e.first.str(), e.second.default_volume, (e.second.ducked > 0) || e.second.stranded);
+            pos += record_size(e.first.str());
+        }
+    }
+
+    const std::string tmp_path(path + ".tmp");
+    mapping* m = mapping::open(tmp_path, round_size(image.size() * 2, min_size), true);
+    if (m)
+        std::memcpy(m->data, image.data(), image.size());
+
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    m_compacting = false;
+    if (!m || !m_map)
+    {
+        if (m)
+        {
+            m->close();
+            delete m;
+        }
+        return false;
+    }
+
+    // the old view goes first, a mapped file can not be replaced on Windows.
+    const size_t old_size = m_map->size;
+    m_map->close();
+    delete m_map;
+    m_map = nullptr;
+
+#ifdef _WIN32
+    const bool renamed = MoveFileExA(tmp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool renamed = std::rename(tmp_path.c_str(), path.c_str()) == 0;
+#endif
+    if (!renamed)
+    {
+        // the original still has every record, those made meanwhile were appended to it as well.
+        printf("volume_journal::compact: Error replacing %s\n", path.c_str());
+        m->close();
+        delete m;
+        std::remove(tmp_path.c_str());
+        for (auto& e : m_state)
+            e.second.dirty = false;
+        m_map = mapping::open(path, old_size, false);
+        if (!m_map)
+            printf("volume_journal::compact: Error mapping %s\n", path.c_str()); // memory only from now on
+        return false;
+    }
+
+    m_map = m;
+    m_tail = image.size();
+    for (auto& e : m_state)
+    {
+        if (e.second.dirty)
+        {
+            e.second.dirty = false;
+            if (!append(e.first.str(), e.second))
+                break;
+        }
+    }
+
+    m_compactions++;
+
+    return true;
+}
+
+auto volume_journal::get_stats() const -> journal_stats
+{
+    std::lock_guard<std::mutex> l(m_mutex);
+
+    journal_stats stats;
+    stats.records = m_records;
+    stats.bytes = m_tail;
+    stats.live = m_state.size();
+    stats.stranded = 0;
+    for (const auto& e : m_state)
+    {
+        if (e.second.stranded)
+            stats.stranded++;
+    }
+    stats.compactions = m_compactions;
+    return stats;
+}
+
+} // end namespace vo
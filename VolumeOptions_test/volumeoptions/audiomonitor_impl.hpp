@@ -0,0 +1,2742 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    AudioMonitor core implementation.
+
+    Include this only from a backend translation unit, after the backend definition, and explicitly
+        instantiate BasicAudioSession<Backend> and BasicAudioMonitor<Backend> there.
+*/
+
+#ifndef VO_AUDIOMONITOR_IMPL_HPP
+#define VO_AUDIOMONITOR_IMPL_HPP
+
+#include <algorithm> // for string conversion
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+
+#include "../volumeoptions/audiomonitor.h"
+
+namespace vo {
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+///////////// Some exported helpers for async calls from other proyects of mine /////////////////////
+/////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Used to sync calls from other threads usign io_service. Generic templates
+namespace detail
+{
+    /*
+        Completion slot of one synchronous call, lives on the caller stack.
+
+        Each call waits on its own slot so completing it wakes only that caller, not every thread
+            blocked on a sync call.
+    */
+    class sync_slot
+    {
+    public:
+        sync_slot() : m_done(false) {}
+
+        void complete()
+        {
+            // notify under the lock, the waiter destroys the slot as soon as it sees m_done.
+            std::lock_guard<std::mutex> l(m_mutex);
+            m_done = true;
+            m_cond.notify_one();
+        }
+
+        void wait()
+        {
+            std::unique_lock<std::mutex> l(m_mutex);
+            while (!m_done) { m_cond.wait(l); };
+        }
+
+    private:
+        sync_slot(const sync_slot&);
+        sync_slot& operator=(const sync_slot&);
+
+        std::mutex m_mutex;
+        std::condition_variable m_cond;
+        bool m_done;
+    };
+
+    /* If compiler supports variadic templates use this, its nicer */
+    /* perfect forwarding,  rvalue references */
+
+    // Simple ASIO proxy async call.
+    template <typename ft, typename... pt>
+    void ASYNC_CALL(const std::shared_ptr<boost::asio::io_service>& io, ft&& f, pt&&... args)
+    {
+        io->post(std::bind(std::forward<ft>(f), std::forward<pt>(args)...));
+    }
+
+    // Does ASIO async call on the strand and waits it to complete.
+    template <typename ft, typename... pt>
+    void SYNC_CALL(boost::asio::io_service::strand& strand, sync_call_latency& latency,
+        ft&& f, pt&&... args)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        auto call = std::bind(std::forward<ft>(f), std::forward<pt>(args)...);
+        sync_slot slot;
+        strand.dispatch([&call, &slot]() { call(); slot.complete(); });
+        slot.wait();
+        latency.record(std::chrono::steady_clock::now() - start);
+    }
+
+    // Does ASIO async call on the strand and waits for return.
+    template <typename rt, typename ft, typename... pt>
+    rt SYNC_CALL_RET(boost::asio::io_service::strand& strand, sync_call_latency& latency,
+        ft&& f, pt&&... args)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        auto call = std::bind(std::forward<ft>(f), std::forward<pt>(args)...);
+        rt r;
+        sync_slot slot;
+        strand.dispatch([&call, &r, &slot]() { r = call(); slot.complete(); });
+        slot.wait();
+        latency.record(std::chrono::steady_clock::now() - start);
+        return r;
+    }
+}
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    //////////////////////////////////////  Audio Session  //////////////////////////////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+template <class Backend>
+BasicAudioSession<Backend>::BasicAudioSession(typename Backend::session_source pSessionControl,
+    const session_info& info, const interned_wstring& sid, const interned_wstring& siid,
+    const std::weak_ptr<monitor_type>& wpAudioMonitor, float default_volume)
+    : m_default_volume(default_volume)
+    , m_is_volume_at_default(true)
+    , m_volume(-1.0f)
+    , m_ramp_from(0.0f)
+    , m_ramp_to(0.0f)
+    , m_ramp_curve(ramp_curve_t::LINEAR)
+    , m_ramp_duration(std::chrono::steady_clock::duration::zero())
+    , m_ramp_index(monitor_type::no_ramp)
+    , m_excluded_flag(false)
+    , m_excluded_generation(0)
+    , m_profile(profile_table::no_profile)
+    , m_volume_command(monitor_type::no_volume_command)
+    , m_session_dead(false)
+    , m_pid(info.pid)
+    , m_sid(sid)
+    , m_siid(siid)
+    , m_hrStatus(S_OK)
+    , m_external_volume(0.0f)
+    , m_external_volume_dirty(false)
+    , m_refresh_epoch(0)
+    , m_wpAudioMonitor(wpAudioMonitor)
+    , m_journal_volume(-1.0f)
+    , m_journal_ducked(false)
+{
+    if (!pSessionControl)
+    {
+        m_hrStatus = E_POINTER;
+        printf("[ERROR] AudioSession::AudioSession pSessionControl == NULL\n");
+        return;
+    }
+
+    dprintf("AudioSession::AudioSession default_volume correction=%f\n", default_volume);
+
+    // NOTE: retaining a reference to a WASAPI session interface causes the session to never expire.
+    CHECK_HR(m_hrStatus = Backend::open_session(m_handle, pSessionControl));
+
+    // Correct volume
+    if (m_default_volume > 1.0f)
+        m_default_volume = 1.0f;
+
+    {
+        // if user default vol not set (negative) set it.
+        float currrent_vol = GetCurrentVolume();
+        m_volume = currrent_vol;
+        if (m_default_volume < 0.0f)
+            UpdateDefaultVolume(currrent_vol);
+
+        // We wont get the state yet, we will get it after enabling events when contructor
+        //  finishes (we enable events after contruction finishes so event callbacks are queued
+        //  correctly with a valid AudioSession shared_ptr).
+        // Set default as active, this also initializes m_last_active_state.
+        set_state(session_state_t::ACTIVE);
+
+        // Fix for Sndvol, if a new session is detected when the process was just
+        //   opened, wasapi volume change won work, no way around it. wait for a bit
+        Backend::settle_new_session();
+
+        // Windows SndVol fix.
+        //  If 'default_volume' param is >= 0 it has the volume of another recently changed same SID volume.
+        //    Sessions with the same SID take their default volume from the last changed SID (>5sec) from the registry,
+        //    *see AudioSession::ApplyVolumeSettings and AudioMonitor::SaveSession for more doc.
+        if (default_volume >= 0.0f)
+        {
+            if (m_is_volume_at_default && (m_default_volume != currrent_vol))
+            {
+                dprintf("AudioSession::AudioSession Windows SndVol fix (%f != %f) , is_volume_at_default =%d\n",
+                    m_default_volume, currrent_vol, m_is_volume_at_default);
+                ChangeVolume(m_default_volume);	// fix correct windows volume before aplying settings
+            }
+        }
+    }
+
+#ifdef _DEBUG
+    {
+        session_state_t State;
+        CHECK_HR(m_hrStatus = Backend::get_state(m_handle, State));
+
+        const wchar_t *pszState = L"?????";
+        switch (State)
+        {
+        case session_state_t::ACTIVE:
+            pszState = L"active";
+            break;
+        case session_state_t::INACTIVE:
+            pszState = L"inactive";
+            break;
+        case session_state_t::EXPIRED: // only shows if we dont retaing a pointer to the session
+            pszState = L"expired";
+            break;
+        }
+        dwprintf(L"*AudioSession::AudioSession Saved SIID PID[%d]: %s State: %s\n", getPID(), getSIID().c_str(),
+            pszState);
+    }
+#endif
+
+done:
+    // Check class status after creation. AudioSession::GetStatus() HRESULT type, if failed discard this session.
+    // NOTE: i dont like exceptions on windows api code.
+    ;
+}
+
+template <class Backend>
+BasicAudioSession<Backend>::~BasicAudioSession()
+{
+    if (!m_session_dead)
+    {
+        dwprintf(L"~AudioSession:: PID[%d]Deleting Session %s\n", getPID(), getSIID().c_str());
+    }
+
+    ShutdownSession();
+
+    // A command queued before the session died may have put it back on the ramp list or the wheel.
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+    if (spAudioMonitor)
+    {
+        spAudioMonitor->CancelRamp(this);
+        spAudioMonitor->CancelTimer(m_restore_timer);
+    }
+}
+
+/*
+    This will render the object basically dead for the backend without destroying it.
+
+    Is necessary to release all wasapi references before enumerating new ones, (wasapi rules...)
+        if we dont release references before enumerating it leaks memory,
+        more info on AudioMonitor::RefreshSessions().
+
+    The reason i had to create this is that i cant destroy the object and release wasapi references on destructor
+        when there are pending queued callbacks with this session shared_ptr references on io_service.
+        for example: there could be queued volume restore cancelled callbacks with a session shared_ptr
+        or queued events callbacks with a session shared_ptr just before session shared_ptr delete.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::ShutdownSession()
+{
+    if (m_session_dead)
+        return;
+
+    // First, before releasing, unregister events.
+    StopEvents();
+
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+
+    // A ramp in flight jumps to its end, its monitor may be already gone (monitor destructor).
+    if (m_ramp_index != monitor_type::no_ramp)
+    {
+        if (spAudioMonitor)
+            spAudioMonitor->CancelRamp(this);
+        m_ramp_index = monitor_type::no_ramp;
+        ChangeVolume(m_ramp_to);
+    }
+
+    // Set Session volume level to default state.
+    RestoreVolume(resume_t::NO_RAMP);
+
+    if (spAudioMonitor)
+    {
+        spAudioMonitor->CancelTimer(m_restore_timer); // the wheel must not keep 'this'
+        // a batched write must reach the OS before the handle goes away.
+        spAudioMonitor->FlushVolume(this);
+    }
+
+    Backend::close_session(m_handle);
+
+    m_session_dead = true;
+}
+
+/*
+    Enables Session notification callbacks
+
+    Registers for new notifications on this session.
+    Refer to Stop/Unregister to more comments on this.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::InitEvents()
+{
+    assert(Backend::is_open(m_handle));
+    if (!Backend::is_open(m_handle)) return;
+
+    // S_FALSE if events were already registered.
+    HRESULT hr = Backend::register_session_events(m_handle, this->shared_from_this(), m_wpAudioMonitor);
+    m_hrStatus = hr;
+    if (hr == S_OK)
+    {
+        dprintf("AudioSession::InitEvents() PID[%d] Init Session Events\n", getPID());
+
+        // After enabling events, set initial state
+        //  we dont know since when it was active/inactive (update after init events).
+        session_state_t State = session_state_t::INACTIVE;
+        CHECK_HR(m_hrStatus = Backend::get_state(m_handle, State));
+        set_state(State);
+    }
+    else
+        assert(SUCCEEDED(hr));
+
+done:;
+}
+
+/*
+    Stop Session notification callbacks
+
+    Its important to follow what MSDN says about this or we could leak memory.
+    http://msdn.microsoft.com/en-us/library/dd368289%28v=vs.85%29.aspx
+    AudioSession, callbacks and general flow is carefuly written so this never occurs.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::StopEvents()
+{
+    // MSDN: "The client should never release the final reference on a WASAPI object during an event callback."
+    // NOTE: using async calls we garantize we can comply to this.
+    HRESULT hr = Backend::unregister_session_events(m_handle);
+    if (hr == S_OK)
+        dprintf("AudioSession::StopEvents() Stopped Session Events on PID[%d]\n", getPID());
+    else if (FAILED(hr))
+        m_hrStatus = hr;
+}
+
+template <class Backend>
+const std::wstring& BasicAudioSession<Backend>::getSID() const
+{
+    return m_sid.str();
+}
+
+template <class Backend>
+const std::wstring& BasicAudioSession<Backend>::getSIID() const
+{
+    return m_siid.str();
+}
+
+template <class Backend>
+DWORD BasicAudioSession<Backend>::getPID() const
+{
+    return m_pid;
+}
+
+template <class Backend>
+float BasicAudioSession<Backend>::GetCurrentVolume() const
+{
+    float current_volume = -1.0f;
+
+    assert(Backend::is_open(m_handle));
+    if (!Backend::is_open(m_handle)) return current_volume;
+
+    CHECK_HR(m_hrStatus = Backend::get_volume(m_handle, current_volume));
+    dprintf("AudioSession::GetCurrentVolume() PID[%d] = %.2f\n", getPID(), current_volume);
+
+done:
+    return current_volume;
+}
+
+/*
+    Simple handler for new sessesion state events.
+    (called from registered backend session events)
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::state_changed_callback_handler(session_state_t newstatus)
+{
+    set_state(newstatus); // set this before calling apply settings
+
+    switch (newstatus)
+    {
+    case session_state_t::ACTIVE:
+        ApplyVolumeSettings();
+        break;
+
+    case session_state_t::INACTIVE:
+        RestoreVolume();
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*
+    Changes Session Volume based on current AudioMonitor settings.
+
+    It gets settings from his AudioMonitor to decide if change vol or not.
+
+    Note: SndVol uses the last changed session's volume on new instances of the same process(SID) as default vol.
+    It takes ~5 sec to register a new volume level back at the registry, key:
+    "HKEY_CURRENT_USER\Software\Microsoft\Internet Explorer\LowRegistry\Audio\PolicyConfig\PropertyStore"
+        (it overwrites sessions with the same SID).
+    See AudioMonitor:SaveSession for how we use the correct default vol value on new monitored sessions.
+*/
+template <class Backend>
+HRESULT BasicAudioSession<Backend>::ApplyVolumeSettings()
+{
+    HRESULT hr = S_OK;
+
+    // A command queued before ShutdownSession may still reach a dead session.
+    if (m_session_dead || !Backend::is_open(m_handle)) return S_OK;
+
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+    if (!spAudioMonitor) return S_OK; // AudioMonitor is currently shuting down, abort.
+
+    // shortcut to this session settings, its application profile or the global ones.
+    const session_settings& ses_setting = spAudioMonitor->SessionSettings(m_profile);
+
+    bool change_vol = true;
+    if (ses_setting.change_only_active_sessions)
+    {   // Only change volume if the session is active
+        if (m_current_state == session_state_t::ACTIVE)
+            change_vol = true;
+        else
+            change_vol = false;
+    }
+
+    if (m_excluded_flag)
+        change_vol = false;
+
+    // if AudioSession::is_volume_at_default is true, the session is at user default volume.
+    // if AudioMonitor::m_auto_change_volume_flag is true, auto volume change is active, else disabled.
+    if (spAudioMonitor->m_auto_change_volume_flag && change_vol)
+    {
+        const float set_vol = ReducedVolume(ses_setting);
+
+        // If m_auto_change_volume_flag is active and we are changing volume, pending restores are no longer velid.
+        spAudioMonitor->CancelTimer(m_restore_timer);
+
+        RampVolume(set_vol, ramp_t::ATTACK);
+        m_is_volume_at_default = false; // mark, session is NOT at user default volume.
+        JournalState();
+
+        dprintf("AudioSession::ApplyVolumeSettings() PID[%d] Changed Volume to %.2f\n",
+            getPID(), set_vol);
+    }
+    else
+    {
+        dprintf("AudioSession::ApplyVolumeSettings() PID[%d] skiped, flag=%d global_vol_reduction = %.2f, "
+            "is_volume_at_default = %d, reduce_vol=%d \n", getPID(), spAudioMonitor->m_auto_change_volume_flag,
+            ses_setting.vol_reduction, m_is_volume_at_default, change_vol);
+    }
+
+    return hr;
+}
+
+/*
+    Volume of this session while ducked with 'ses_setting'.
+*/
+template <class Backend>
+float BasicAudioSession<Backend>::ReducedVolume(const session_settings& ses_setting) const
+{
+    const float& current_vol_reduction = ses_setting.vol_reduction;
+
+    float set_vol;
+    if (ses_setting.treat_vol_as_percentage)
+    {
+        assert((current_vol_reduction >= -1.0f) && (current_vol_reduction <= 1.0f));
+        // if negative, will actually increase volume! (limit -1.0f to 1.0f)
+        set_vol = m_default_volume * (1.0f - current_vol_reduction); // %
+
+        if (set_vol > 1.0f) set_vol = 1.0f;
+    }
+    else
+    {
+        assert((current_vol_reduction >= 0.0f) && (current_vol_reduction <= 1.0f));
+        set_vol = 1.0f - current_vol_reduction; // fixed (limit 0.0f to 1.0f)
+    }
+
+    return set_vol;
+}
+
+/*
+    Sets new volume level as default for restore.
+
+    Used when user changed volume manually while monitoring, this updates his preference as new default,
+        this should be called from onVolumeChange callbacks when contextGUID is different of ours.
+    It means we didnt change the volume. If not using events, defaults will be updated only when
+        AudioMonitor is refreshing.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::UpdateDefaultVolume(const float new_def)
+{
+    // The user moved the volume, a ramp in flight would fight him.
+    if (m_ramp_index != monitor_type::no_ramp)
+    {
+        std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+        if (spAudioMonitor)
+            spAudioMonitor->CancelRamp(this);
+    }
+    m_volume = new_def;
+
+    m_default_volume = new_def;
+    touch();
+    JournalState();
+
+    dprintf("AudioSession::UpdateDefaultVolume PID[%d] (%.2f)\n", getPID(), new_def);
+}
+
+/*
+    Restores Default session volume
+
+    The session m_default_volume always have the user preferred session default volume.
+    If 'is_volume_at_default' flag is true it means the session is already at user default level.
+    If is false it means we have to restore it.
+
+    callback_type  -> optional parameter (default NORMAL) to indicate if we should
+        create a callback timer (if configured to do so) or change vol without delay (NO_DELAY).
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::RestoreVolume(resume_t callback_type)
+{
+    if (!m_is_volume_at_default)
+    {
+        if (callback_type == resume_t::NORMAL)
+        {
+            // callback_type should be no_delay when chain called from AudioMonitor destructor...
+            std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+            if (!spAudioMonitor) callback_type = resume_t::NO_DELAY; // AudioMonitor is currently shuting down.
+
+            std::shared_ptr<BasicAudioSession> spAudioSession;
+            // callback_type should be no_delay when called from AudioSession destructor...
+            try { spAudioSession = this->shared_from_this(); }
+            catch (std::bad_weak_ptr&) { callback_type = resume_t::NO_DELAY; }
+
+            // if delays are configured schedule a monitor timer to "self" call with callback_type = NO_DELAY
+            //		see AudioMonitor::OnTimer.
+            // a dead session is never scheduled, the wheel would outlive it.
+            if ((callback_type == resume_t::NORMAL) && !m_session_dead &&
+                spAudioMonitor->SessionSettings(m_profile).vol_up_delay != std::chrono::milliseconds::zero())
+            {
+                // to be extra safe
+                if (!spAudioSession) return;
+#ifdef _DEBUG
+                if (spAudioMonitor->m_timers.pending(m_restore_timer))
+                    dprintf("AudioSession::RestoreVolume PID[%d] A pending restore timer is waiting... "
+                    "stopping old timer and replacing it... \n", getPID());
+#endif
+                // IMPORTANT: Cancel the timer when :
+                //		1. We restore with no delay.
+                //		2. We change session volume to non default value.
+                //		3. A session is removed from container or shut down. (AudioMonitor)
+                // The wheel only holds 'this', it must never outlive the session.
+                spAudioMonitor->ScheduleTimer(m_restore_timer,
+                    spAudioMonitor->SessionSettings(m_profile).vol_up_delay,
+                    monitor_type::timer_kind_t::RESTORE, this);
+
+                dprintf("AudioSession::RestoreVolume PID[%d] Scheduled delayed restore\n", getPID());
+
+                return;
+            }
+        }
+
+        // Restore volume delay timer is no longer needed, caducated.
+        std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+        if (spAudioMonitor)
+            spAudioMonitor->CancelTimer(m_restore_timer);
+        // else  AudioMonitor is currently shuting down, its timers are gone.
+
+        // Now... restore
+        if (callback_type == resume_t::NO_RAMP)
+        {
+            if (spAudioMonitor)
+                spAudioMonitor->CancelRamp(this);
+            ChangeVolume(m_default_volume);
+        }
+        else
+            RampVolume(m_default_volume, ramp_t::RELEASE);
+
+        dprintf("AudioSession::RestoreVolume PID[%d] Restoring Volume of Session to %.2f\n", getPID(), m_default_volume);
+
+        m_is_volume_at_default = true; // session is at default volume
+        JournalState();
+    }
+    else
+    {
+        dprintf("AudioSession::RestoreVolume PID[%d] Restoring Volume already at default state = %.2f\n", getPID(), m_default_volume);
+    }
+
+    return;
+}
+
+/*
+    Appends to the journal only when the default volume or the duck state changed since the last record.
+    Journal compaction is handed to the monitor reactor, or done here if the monitor is gone.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::JournalState()
+{
+    if (!m_journal)
+        return;
+
+    const bool ducked = !m_is_volume_at_default;
+    if ((ducked == m_journal_ducked) && (m_default_volume == m_journal_volume))
+        return;
+
+    const int ducked_delta = (ducked == m_journal_ducked) ? 0 : (ducked ? 1 : -1);
+    m_journal_ducked = ducked;
+    m_journal_volume = m_default_volume;
+
+    if (m_journal->record(m_sid, m_default_volume, ducked_delta))
+    {
+        std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+        if (spAudioMonitor)
+            spAudioMonitor->CompactJournal();
+        else
+            m_journal->compact();
+    }
+}
+
+/*
+    Forces/Changes session volume level.
+
+    Inside a monitor volume batch the write is deferred to the end of the tick.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::ChangeVolume(const float v)
+{
+    if (!Backend::is_open(m_handle)) return;
+
+    m_volume = v;
+
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+    if (!spAudioMonitor)
+    {
+        CHECK_HR(m_hrStatus = Backend::set_volume(m_handle, v));
+    }
+    else if (!spAudioMonitor->QueueVolume(this, v))
+    {
+        CHECK_HR(spAudioMonitor->WriteVolume(this, v));
+    }
+    touch();
+
+    dprintf("AudioSession::ChangeVolume PID[%d] new volume level = %.2f\n", getPID(), v);
+
+done:;
+}
+
+/*
+    Moves session volume to 'target' with the configured attack or release ramp.
+
+    A ramp already in flight is retargeted from where it is now, so a new talker during a release
+        turns around smoothly. Without ramp time (or monitor) volume changes at once.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::RampVolume(const float target, const ramp_t ramp)
+{
+    if (m_session_dead || !Backend::is_open(m_handle)) return; // nothing to ramp, see ShutdownSession
+
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+
+    std::chrono::milliseconds duration(0);
+    if (spAudioMonitor)
+    {
+        const session_settings& ses_setting = spAudioMonitor->SessionSettings(m_profile);
+        duration = (ramp == ramp_t::ATTACK) ? ses_setting.vol_attack : ses_setting.vol_release;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const float from = (m_ramp_index != monitor_type::no_ramp) ? RampValue(now) : m_volume;
+
+    if ((duration <= std::chrono::milliseconds::zero()) || (from < 0.0f) || (std::fabs(target - from) < 0.0001f))
+    {
+        if (spAudioMonitor)
+            spAudioMonitor->CancelRamp(this);
+        if (m_volume != target)
+            ChangeVolume(target);
+        return;
+    }
+
+    m_ramp_from = from;
+    m_ramp_to = target;
+    m_ramp_curve = spAudioMonitor->SessionSettings(m_profile).ramp_curve;
+    m_ramp_start = now;
+    m_ramp_duration = duration;
+    spAudioMonitor->AddRamp(this);
+
+    dprintf("AudioSession::RampVolume PID[%d] %.2f -> %.2f in %lldms\n", getPID(), from, target,
+        (long long)duration.count());
+}
+
+/*
+    Volume of the ramp in flight at time 'now'.
+*/
+template <class Backend>
+float BasicAudioSession<Backend>::RampValue(const std::chrono::steady_clock::time_point now) const
+{
+    if (now >= m_ramp_start + m_ramp_duration)
+        return m_ramp_to;
+
+    const float t = std::chrono::duration<float>(now - m_ramp_start).count() /
+        std::chrono::duration<float>(m_ramp_duration).count();
+
+    if (m_ramp_curve == ramp_curve_t::DB)
+    {
+        // interpolate decibels, silence is floored at -60dB so it can be reached.
+        const float floor_db = -60.0f;
+        const float from_db = (m_ramp_from > 0.001f) ? 20.0f * std::log10(m_ramp_from) : floor_db;
+        const float to_db = (m_ramp_to > 0.001f) ? 20.0f * std::log10(m_ramp_to) : floor_db;
+        float v = std::pow(10.0f, (from_db + (to_db - from_db) * t) / 20.0f);
+        return (v > 1.0f) ? 1.0f : v;
+    }
+
+    return m_ramp_from + (m_ramp_to - m_ramp_from) * t;
+}
+
+/*
+    Marks this session as the last modified of its SID group
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::touch()
+{
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+    if (spAudioMonitor)
+        spAudioMonitor->m_saved_sessions.touch(m_slot);
+}
+
+/*
+    Used to keep track of session state and when it changed if using events.
+    So we dont use expensive OS calls.
+    Also keeps the monitor expiry index up to date.
+*/
+template <class Backend>
+void BasicAudioSession<Backend>::set_state(session_state_t state)
+{
+    switch (state)
+    {
+    case session_state_t::ACTIVE:
+        dprintf("AudioSession::set_state PID[%d] m_last_active_state to max()\n", getPID());
+        m_last_active_state = std::chrono::steady_clock::time_point::max();
+        m_current_state = session_state_t::ACTIVE;
+        break;
+
+    case session_state_t::INACTIVE:
+    case session_state_t::EXPIRED:
+        dprintf("AudioSession::set_state PID[%d]  m_last_active_state to now()\n", getPID());
+        m_last_active_state = std::chrono::steady_clock::now();
+        m_current_state = session_state_t::INACTIVE;
+        break;
+    }
+
+    std::shared_ptr<monitor_type> spAudioMonitor(m_wpAudioMonitor.lock());
+    if (spAudioMonitor)
+        spAudioMonitor->UpdateExpiry(this);
+}
+
+
+    /////////////////////////////////////////////////////////////////////////////////////////////
+    //////////////                      AudioMonitor                               //////////////
+    /////////////////////////////////////////////////////////////////////////////////////////////
+
+// NOTE TODO: these two will be deleted when my IPC module is complete.
+template <class Backend>
+std::set<std::wstring> BasicAudioMonitor<Backend>::m_current_monitored_deviceids;
+template <class Backend>
+std::mutex BasicAudioMonitor<Backend>::m_static_set_access;
+
+template <class Backend>
+BasicAudioMonitor<Backend>::BasicAudioMonitor(const std::wstring& device_id)
+    : BasicAudioMonitor(std::shared_ptr<monitor_reactor>(), device_id)
+{}
+
+template <class Backend>
+BasicAudioMonitor<Backend>::BasicAudioMonitor(const std::shared_ptr<monitor_reactor>& reactor,
+    const std::wstring& device_id)
+    : m_follow_default(device_id.empty())
+    , m_endpoint_lost(false)
+    , m_filter_generation(1)
+#ifdef VO_ENABLE_EVENTS
+    , m_inactive_timeout(120) // sessions older than this are deleted.
+#endif
+    , m_timers(std::chrono::milliseconds(5))
+    , m_auto_change_volume_flag(false)
+    , m_current_status(monitor_status_t::INITERROR)
+    , m_error_status(monitor_error_t::OK)
+    , m_carried_ducks(nullptr)
+    , m_migrations(0)
+    , m_ducks_carried(0)
+    , m_sessions_retired(0)
+    , m_refresh_epoch(0)
+    , m_refreshes(0)
+    , m_refresh_listed(0)
+    , m_refresh_added(0)
+    , m_refresh_vanished(0)
+    , m_volume_batch_depth(0)
+    , m_reactor(reactor)
+    , m_abort(false)
+    , m_handlers_pending(0)
+    , m_commands(command_ring_size)
+    , m_drain_pending(false)
+    , m_commands_overflowed(false)
+    , m_commands_pushed(0)
+    , m_command_batches(0)
+    , m_command_overflows(0)
+    , m_volume_changes(0)
+    , m_volume_coalesced(0)
+    , m_wheel_armed_at(std::chrono::steady_clock::time_point::max())
+    , m_ramp_cursor(0)
+    , m_volume_writes(0)
+    , m_volume_writes_throttled(0)
+    , m_io_active(false)
+{
+    HRESULT hr = S_OK;
+
+    PublishSettings(); // defaults
+
+    hr = InitDeviceID(device_id); // if empty will use default endpoint.
+    if (FAILED(hr))
+        return;
+
+    m_processid = Backend::current_process_id();
+    m_filter = process_filter(m_settings, m_processid);
+
+    if (m_error_status != monitor_error_t::DEVICEID_IN_USE)
+    {
+        StartIOInit();
+    }
+}
+
+template <class Backend>
+std::shared_ptr<monitor_reactor> BasicAudioMonitor<Backend>::CreateReactor(unsigned threads)
+{
+    return std::make_shared<monitor_reactor>(threads, &Backend::thread_init);
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::StartIOInit()
+{
+    // Start handling calls after pre init is complete, on our own thread if no reactor was given.
+    // m_current_status flag will be set to ok when thread init is complete.
+    if (!m_reactor)
+        m_reactor = CreateReactor(1);
+    m_io = m_reactor->get_io();
+    m_strand.reset(new boost::asio::io_service::strand(*m_io));
+    m_io_active = true;
+
+    dprintf("\n\t...AudioMonitor IO Init, %u reactor threads\n\n", static_cast<unsigned>(m_reactor->size()));
+
+    // When the strand runs, m_current_status flag will be set and finish init.
+    Post([this]() { FinishIOInit(); });
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::FinishIOInit()
+{
+    m_current_status = monitor_status_t::STOPPED;
+
+    dprintf("\t--AudioMonitor init complete--\n");
+}
+
+/*
+    The reactor may be shared, so instead of stopping it we stop using it: ShutdownIO runs on the strand,
+        after it nothing new is armed and queued handlers return without running, then we wait for them.
+    Must not run on a monitor handler (last reference released there), it would wait for itself.
+*/
+template <class Backend>
+BasicAudioMonitor<Backend>::~BasicAudioMonitor()
+{
+    if (m_io_active)
+    {
+        detail::SYNC_CALL(*m_strand, m_sync_latency, &BasicAudioMonitor::ShutdownIO, this);
+        m_io_active = false; // public methods run on this thread from now on
+
+        while (m_handlers_pending.load() != 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    DiscardCommands();
+    {
+        std::lock_guard<std::mutex> l(m_static_set_access);
+        m_current_monitored_deviceids.erase(m_wsDeviceID);
+    }
+
+    // Stop everything and restore to default state
+    // Unregister Event callbacks before destruction
+    //	if we dont want memory leaks.
+    // and delete all references to AudioSessions.
+    Stop();
+
+    Backend::close_manager(m_manager);
+
+    dprintf("\n\t...AudioMonitor destroyed succesfuly.\n");
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::ShutdownIO()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    m_abort = true;
+    Backend::unwatch_endpoints(m_endpoint_watch); // listeners only hold a weak reference
+    m_wheel_timer.reset(); // its pending wait completes with operation_aborted
+    m_wheel_armed_at = std::chrono::steady_clock::time_point::max();
+}
+
+/*
+    Runs f on m_strand holding m_mutex, like every monitor handler.
+    Handlers only capture this, the destructor waits for m_handlers_pending so it stays valid.
+*/
+template <class Backend>
+template <class F>
+void BasicAudioMonitor<Backend>::Post(F f)
+{
+    m_handlers_pending.fetch_add(1);
+    m_strand->post([this, f]()
+    {
+        {
+            std::lock_guard<std::recursive_mutex> guard(m_mutex);
+            if (!m_abort)
+                f();
+        }
+        m_handlers_pending.fetch_sub(1);
+    });
+}
+
+/*
+    Simple get for asio io_service of AudioMonitor
+
+    In case we need to queue calls from other places.
+    It is the reactor io_service, handlers posted to it are not serialized with the monitor (it uses a strand)
+        and may be shared with other monitors.
+    Warning: When class is destroyed, user will have to reset this pointer, is no longer useful.
+    But it garantees it wont be destroyed when using it.
+*/
+template <class Backend>
+std::shared_ptr<boost::asio::io_service> BasicAudioMonitor<Backend>::get_io() const
+{
+    return m_io;
+}
+
+/*
+    Decides how a public method runs, l is a deferred lock on m_mutex.
+
+    Returns true with l locked if the caller is running on m_strand (the lock is recursive, handlers hold it)
+        or no handler can run anymore. Returns false if the call must be marshalled with SYNC_CALL,
+        backend callbacks and user/plugin threads are then handled sequentially on the strand.
+    Checking the strand instead of probing m_mutex keeps waiting callers off it.
+*/
+template <class Backend>
+bool BasicAudioMonitor<Backend>::EnterMonitor(std::unique_lock<std::recursive_mutex>& l)
+{
+    if (m_io_active && !m_strand->running_in_this_thread())
+        return false;
+
+    l.lock();
+    return true;
+}
+
+template <class Backend>
+std::set<std::wstring> BasicAudioMonitor<Backend>::GetCurrentMonitoredEndpoints()
+{
+    std::lock_guard<std::mutex> l(m_static_set_access);
+
+    return m_current_monitored_deviceids;
+}
+
+/*
+    Handy Method to enumerates all audio endpoints devices.
+
+    This method can be used to obtain ids of audio endpoint and use them on AudioMonitor constructor.
+    Returns a map of wstrings DeviceIDs -> FriendlyName. Use desired wstring DeviceID on AudioMonitor creation.
+    dwStateMask meaning depends on the backend, see WasapiSessionBackend::get_endpoints_info.
+
+    On this method you have to manually check return on error.
+*/
+template <class Backend>
+HRESULT BasicAudioMonitor<Backend>::GetEndpointsInfo(std::map<std::wstring, std::wstring>& audio_endpoints,
+    DWORD dwStateMask)
+{
+    return Backend::get_endpoints_info(audio_endpoints, dwStateMask);
+}
+
+template <class Backend>
+HRESULT BasicAudioMonitor<Backend>::InitDeviceID(const std::wstring& _device_id)
+{
+    HRESULT hr = S_OK;
+
+    std::wstring device_id(_device_id);
+    // if empty, will be set with default endpoint if no errors occurs.
+    hr = Backend::open_manager(m_manager, device_id);
+    if (FAILED(hr))
+    {
+        if (hr == E_NOTFOUND)
+        {
+            std::cerr << "ERROR InitDeviceID() The device ID does not identify an audio device"
+                "that is in this system. " << std::endl;
+            m_error_status = monitor_error_t::DEVICE_NOT_FOUND;
+        }
+        std::wcerr << "ERROR InitDeviceID(" << _device_id << ")  HRESULT : " << hr << std::endl;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> l(m_static_set_access);
+        // if we are already monitoring this endpoint, abort
+        if (m_current_monitored_deviceids.count(device_id))
+        {
+            // todo heavy: check if other process or instance is using it and continue, dont return, then sync.
+            // TODO UPDATE: working on IPC module.
+            std::cerr << "AudioMonitor::InitDeviceID() ERROR: Already monitoring this DeviceID endpoint" << std::endl;
+            m_error_status = monitor_error_t::DEVICEID_IN_USE;
+        }
+        else
+        {
+            // static set so we dont monitor the same endpoints on multiple instances of AudioMonitor.
+            m_current_monitored_deviceids.insert(device_id);
+            m_wsDeviceID = device_id;
+            dprintf("AudioMonitor::InitDeviceID()  Using Device Status: OK.\n");
+        }
+    }
+
+    return hr;
+}
+
+template <class Backend>
+std::wstring BasicAudioMonitor<Backend>::GetDeviceID() const
+{
+    std::lock_guard<std::mutex> l(m_static_set_access);
+
+    return m_wsDeviceID;
+}
+
+/*
+    Moves the monitor to another endpoint, L"" follows the default endpoint from now on.
+
+    Unlike Stop + Start sessions are not restored and ducked again, see MigrateEndpoint.
+    Returns S_FALSE if already there, E_NOTFOUND for unknown endpoints and E_INVALIDARG if the endpoint
+        is monitored by another AudioMonitor, the monitor stays where it was on errors.
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::ChangeDeviceID(const std::wstring& device_id)
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::ChangeDeviceID, this,
+            std::cref(device_id));
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        m_follow_default = device_id.empty();
+        ret = MigrateEndpoint(device_id);
+    }
+
+    return static_cast<long>(ret);
+}
+
+/*
+    Sessions of the same app on different endpoints only differ in the endpoint part of the SID,
+        SndVol SIDs start with the endpoint id up to the first '|'.
+*/
+template <class Backend>
+std::wstring BasicAudioMonitor<Backend>::AppKey(const std::wstring& sid)
+{
+    const size_t bar = sid.find(L'|');
+    return (bar == std::wstring::npos) ? sid : sid.substr(bar + 1);
+}
+
+/*
+    Registers for endpoint changes, once, the listener only holds a weak reference.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::WatchEndpoints()
+{
+    std::weak_ptr<BasicAudioMonitor> wpAudioMonitor(this->shared_from_this());
+
+    HRESULT hr = Backend::watch_endpoints(m_endpoint_watch,
+        [wpAudioMonitor](endpoint_event_t e, const std::wstring& device_id)
+    {
+        std::shared_ptr<BasicAudioMonitor> spAudioMonitor(wpAudioMonitor.lock());
+        if (!spAudioMonitor)
+            return;
+
+        BasicAudioMonitor* pam = spAudioMonitor.get();
+        std::wstring id(device_id);
+        spAudioMonitor->Post([pam, e, id]() { pam->OnEndpointEvent(e, id); });
+    });
+    if (FAILED(hr))
+        std::cerr << "AudioMonitor::WatchEndpoints() ERROR: endpoint notifications unavailable: " << hr << std::endl;
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::OnEndpointEvent(endpoint_event_t e, const std::wstring& device_id)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    switch (e)
+    {
+    case endpoint_event_t::DEFAULT_CHANGED:
+        if (m_follow_default && (device_id != m_wsDeviceID))
+            MigrateEndpoint(device_id);
+        break;
+
+    case endpoint_event_t::REMOVED:
+        if (device_id != m_wsDeviceID)
+            break;
+        dwprintf(L"AudioMonitor::OnEndpointEvent() Endpoint removed %s\n", device_id.c_str());
+        // its sessions are gone, a default endpoint change moves us if we follow it.
+        m_endpoint_lost = true;
+        RetireSessions();
+        break;
+
+    case endpoint_event_t::ADDED:
+        if (m_endpoint_lost && (device_id == m_wsDeviceID))
+            MigrateEndpoint(device_id); // plugged back in, reopen it
+        break;
+    }
+}
+
+/*
+    Switches m_manager to another endpoint in place, the monitor status is kept.
+
+    A Stop would restore every session and the Start that follows would duck them again, an audible jump
+        when a headset is plugged in mid conversation. Instead:
+        - sessions of the old endpoint are retired as they are (ducked or not) and torn down later,
+            a few per tick, see RetireTick. Streams moved to the new endpoint leave them silent anyway.
+        - new endpoint sessions are saved at once (enumeration + notifications) and take the duck state
+            of the same app on the old endpoint, see CarryDuck.
+    Only runs on the monitor strand.
+*/
+template <class Backend>
+HRESULT BasicAudioMonitor<Backend>::MigrateEndpoint(const std::wstring& device_id)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    HRESULT hr = S_OK;
+
+    typename Backend::manager_handle manager;
+    std::wstring new_id(device_id);
+    hr = Backend::open_manager(manager, new_id);
+    if (FAILED(hr))
+        return hr;
+
+    if ((new_id == m_wsDeviceID) && !m_endpoint_lost)
+    {
+        Backend::close_manager(manager);
+        return S_FALSE;
+    }
+
+    {
+        std::lock_guard<std::mutex> l(m_static_set_access);
+        if ((new_id != m_wsDeviceID) && m_current_monitored_deviceids.count(new_id))
+        {
+            std::wcerr << L"AudioMonitor::MigrateEndpoint() ERROR: Already monitoring " << new_id << std::endl;
+            Backend::close_manager(manager);
+            return E_INVALIDARG;
+        }
+        m_current_monitored_deviceids.erase(m_wsDeviceID);
+        m_current_monitored_deviceids.insert(new_id);
+        m_wsDeviceID = new_id;
+    }
+
+    dwprintf(L"\n\t .... AudioMonitor::MigrateEndpoint() to %s ----\n\n", new_id.c_str());
+
+    {
+        const bool live = (m_current_status == monitor_status_t::RUNNING) ||
+            (m_current_status == monitor_status_t::PAUSED);
+        carried_ducks ducks(SnapshotDucks());
+
+        RetireSessions();
+
+        // no new sessions from the old endpoint, then let it go.
+        std::swap(m_manager, manager);
+        Backend::close_manager(manager);
+        m_endpoint_lost = false;
+
+        if (live)
+        {
+            volume_batch_scope batch(*this);
+
+            m_carried_ducks = &ducks;
+            hr = Backend::enumerate_sessions(m_manager, [this](typename Backend::session_source s)
+            {
+                SaveSession(s, false);
+            });
+            m_carried_ducks = nullptr;
+
+#ifdef VO_ENABLE_EVENTS
+            HRESULT hr_events = Backend::register_notifications(m_manager, this->shared_from_this());
+            if (FAILED(hr_events))
+                hr = hr_events;
+#endif
+        }
+    }
+
+    m_migrations++;
+
+    return hr;
+}
+
+/*
+    Duck state of every app on the current and retired sessions, keyed by AppKey.
+    Apps at their default volume are left out, their new sessions just follow the settings.
+*/
+template <class Backend>
+auto BasicAudioMonitor<Backend>::SnapshotDucks() const -> carried_ducks
+{
+    carried_ducks ducks;
+
+    auto add = [this, &ducks](const std::shared_ptr<session_type>& s)
+    {
+        if (s->m_is_volume_at_default || s->m_session_dead)
+            return;
+        carried_duck& d = ducks.insert(std::make_pair(AppKey(s->getSID()),
+            carried_duck{ std::chrono::steady_clock::time_point::min() })).first->second;
+        d.restore_due = (std::max)(d.restore_due, m_timers.due(s->m_restore_timer));
+    };
+    for (const auto& s : m_saved_sessions)
+        add(s);
+    for (const auto& s : m_retired_sessions)
+        add(s);
+
+    return ducks;
+}
+
+/*
+    Gives a session saved during a migration the duck state its app had on the old endpoint.
+
+    Running, ApplyVolumeSettings already aimed at the ducked volume, it is set at once instead of with
+        the attack ramp (the app was already ducked). Paused inside vol_up_delay, the session is ducked
+        too and restored when the old one would have been.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::CarryDuck(session_type* session)
+{
+    auto it = m_carried_ducks->find(AppKey(session->getSID()));
+    if (it == m_carried_ducks->end())
+        return;
+
+    if (m_auto_change_volume_flag)
+    {
+        if (session->m_is_volume_at_default)
+            return; // inactive or excluded here
+        if (session->m_ramp_index != no_ramp)
+        {
+            CancelRamp(session);
+            session->ChangeVolume(session->m_ramp_to);
+        }
+    }
+    else
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const auto due = it->second.restore_due;
+        if (session->m_excluded_flag || (due == std::chrono::steady_clock::time_point::max()) || (due <= now))
+            return;
+
+        session->ChangeVolume(session->ReducedVolume(SessionSettings(session->m_profile)));
+        session->m_is_volume_at_default = false;
+        session->JournalState();
+        ScheduleTimer(session->m_restore_timer, due - now, timer_kind_t::RESTORE, session);
+    }
+
+    m_ducks_carried++;
+}
+
+/*
+    Moves every saved session to m_retired_sessions without touching its volume.
+
+    Retired sessions keep their events and timers but are no longer in m_saved_sessions, so they do not
+        mix with the new endpoint sessions (SID groups, expiry). Pause restores them, Stop drops them.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::RetireSessions()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    for (auto& s : m_saved_sessions)
+    {
+        s->m_slot = slot_handle(); // the table is cleared below, its handles would match new slots
+        m_retired_sessions.push_back(s);
+    }
+    m_saved_sessions.clear();
+    ArmExpireTimer();
+
+    if (!m_retired_sessions.empty() && !m_timers.pending(m_retire_timer))
+        ScheduleTimer(m_retire_timer, std::chrono::milliseconds(retire_delay_ms), timer_kind_t::RETIRE);
+}
+
+/*
+    Tears down up to retire_batch retired sessions (restores them on the old endpoint and releases them).
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::RetireTick()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    const size_t n = (std::min)(m_retired_sessions.size(), static_cast<size_t>(retire_batch));
+    {
+        volume_batch_scope batch(*this);
+        for (size_t i = m_retired_sessions.size() - n; i < m_retired_sessions.size(); ++i)
+            m_retired_sessions[i]->ShutdownSession();
+    }
+    m_retired_sessions.resize(m_retired_sessions.size() - n);
+    m_sessions_retired += n;
+
+    if (!m_retired_sessions.empty())
+        ScheduleTimer(m_retire_timer, m_settings.ramp_interval, timer_kind_t::RETIRE);
+}
+
+/*
+    Tears down every retired session now.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::DropRetiredSessions()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    CancelTimer(m_retire_timer);
+
+    std::vector<std::shared_ptr<session_type>> retired;
+    retired.swap(m_retired_sessions);
+    for (auto& s : retired)
+        s->ShutdownSession();
+    m_sessions_retired += retired.size();
+}
+
+/*
+    Syncs saved sessions with the backend enumerator, by SIID.
+
+    Uses the backend enumerator (windows7+ on WASAPI) to list all SndVol sessions, only the SIID of each
+        one is read, sessions already saved are just marked as listed, new ones go through SaveSession.
+    Saved sessions the enumerator no longer lists are retired (see RetireSession).
+    The expensive part (session info, events, default volume lookups) is proportional to the churn since
+        the last refresh, not to the number of saved sessions, so it is cheap to call on a running monitor.
+
+    NOTE: this is requiered for NewSessionNotifications to start working from a stop.
+         more notes inside.
+*/
+template <class Backend>
+HRESULT BasicAudioMonitor<Backend>::RefreshSessions()
+{
+    if (!Backend::manager_ready(m_manager))
+        return E_INVALIDARG;
+
+    HRESULT hr = S_OK;
+
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    dprintf("\n\n------ Refreshing sessions...\n\n");
+
+    // Sessions saved during the pass (here or by SaveSession from a notification) take the new epoch.
+    const uint32_t epoch = ++m_refresh_epoch;
+
+    // Get the current list of sessions.
+    // IMPORTANT NOTE: Start refreshes from a stop, with no saved references to IAudioSessionControl,
+    //      retaining them before the first enumeration causes memory leaks.
+    // IMPORTANT NOTE2: We have to use this call if we want to receive new session notifications
+    // http://msdn.microsoft.com/en-us/library/dd368281%28v=vs.85%29.aspx point 5. (verified)
+    const bool unref_there = false;
+    hr = Backend::enumerate_sessions(m_manager, [this, epoch, unref_there](typename Backend::session_source s)
+    {
+        std::wstring siid;
+        if (SUCCEEDED(Backend::get_session_instance_id(s, siid)))
+        {
+            // never interned, never saved.
+            const slot_handle h = m_saved_sessions.find(string_pool::global().find(siid).id());
+            if (h.valid())
+            {
+                (*m_saved_sessions.get(h))->m_refresh_epoch = epoch;
+                m_refresh_listed++;
+                return;
+            }
+        }
+
+        const size_t saved = m_saved_sessions.size();
+        SaveSession(s, unref_there); // TODO handle error.
+        if (m_saved_sessions.size() != saved)
+            m_refresh_added++;
+    });
+
+    // A failed enumeration lists nothing, that does not mean every session is gone.
+    if (SUCCEEDED(hr))
+    {
+        std::vector<slot_handle> vanished;
+        for (auto it = m_saved_sessions.begin(); it != m_saved_sessions.end(); ++it)
+        {
+            if ((*it)->m_refresh_epoch != epoch)
+                vanished.push_back(it.handle());
+        }
+        for (const slot_handle& h : vanished)
+            RetireSession(h);
+        m_refresh_vanished += vanished.size();
+    }
+
+    m_refreshes++;
+
+    return hr;
+}
+
+/*
+    Moves one saved session to m_retired_sessions, see RetireSessions.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::RetireSession(slot_handle h)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    std::shared_ptr<session_type>* saved = m_saved_sessions.get(h);
+    if (!saved)
+        return;
+
+    std::shared_ptr<session_type> s(*saved);
+    m_saved_sessions.erase(h);
+    s->m_slot = slot_handle();
+    m_retired_sessions.push_back(std::move(s));
+    ArmExpireTimer();
+
+    if (!m_timers.pending(m_retire_timer))
+        ScheduleTimer(m_retire_timer, std::chrono::milliseconds(retire_delay_ms), timer_kind_t::RETIRE);
+}
+
+/*
+    Releases, restores and deletes all saved sessions.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::DeleteSessions()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    DropRetiredSessions();
+
+    // Use shutdown first to delete all backend internal references
+    // (it will leave the session at default state and cancel its pending restore),
+    // more info on AudioSession::ShutdownSession()
+    for (auto& s : m_saved_sessions)
+    {
+        s->ShutdownSession();
+    }
+    // then delete map to erase sesion shared_ptr references.
+    m_saved_sessions.clear();
+
+    // Ramps of sessions still alive elsewhere jump to their end, nothing keeps ramping after a Stop.
+    {
+        volume_batch_scope batch(*this);
+        while (!m_ramps.empty())
+        {
+            session_type* s = m_ramps.back();
+            CancelRamp(s);
+            s->ChangeVolume(s->m_ramp_to);
+        }
+    }
+    CancelTimer(m_ramp_timer);
+
+    dwprintf(L"AudioMonitor::DeleteSessions() Saved sessions cleared\n");
+}
+
+/*
+    Called by the expiry timer when the oldest inactive session times out, or manually to delete
+        expired sessions.
+
+    We have to implement this because when wont get expired status
+        callbacks when we retain WASAPI references.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::DeleteExpiredSessions()
+{
+    ExpireSessions(std::chrono::steady_clock::now());
+}
+
+/*
+    Deletes sessions inactive for at least m_inactive_timeout at time 'now'.
+
+    Only expired sessions are visited, the saved sessions inactive list is ordered by inactivity time.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::ExpireSessions(const std::chrono::steady_clock::time_point now)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    for (;;)
+    {
+        const slot_handle oldest = m_saved_sessions.oldest_inactive();
+        if (!oldest.valid())
+            break;
+
+        session_type* s = m_saved_sessions.get(oldest)->get();
+        if (now - s->m_last_active_state < m_inactive_timeout)
+            break;
+
+        dwprintf(L"\nSession PID[%d] Too old, removing...\n", s->getPID());
+        //  NOTE: cancel the restore first, the session may outlive the table
+        //      if a queued callback still holds it.
+        CancelTimer(s->m_restore_timer);
+
+        m_saved_sessions.erase(oldest);
+    }
+
+    ArmExpireTimer();
+
+    dwprintf(L". DeleteExpired tick\n");
+}
+
+/*
+    Keeps a saved session's place in the inactive list in sync with its state, see BasicAudioSession::set_state.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::UpdateExpiry(session_type* session)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    if (!m_saved_sessions.get(session->m_slot))
+        return; // not saved yet, SaveSession calls again once it is.
+
+    const slot_handle oldest = m_saved_sessions.oldest_inactive();
+
+    if (session->m_current_state == session_state_t::ACTIVE)
+        m_saved_sessions.remove_inactive(session->m_slot);
+    else
+        m_saved_sessions.push_inactive(session->m_slot);
+
+    if (m_saved_sessions.oldest_inactive() != oldest)
+        ArmExpireTimer();
+}
+
+/*
+    Schedules the expiry timer for when the oldest inactive session times out.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::ArmExpireTimer()
+{
+#ifdef VO_ENABLE_EVENTS
+    const slot_handle oldest = m_saved_sessions.oldest_inactive();
+    if (!oldest.valid())
+    {
+        CancelTimer(m_expire_timer);
+        return;
+    }
+
+    const session_type* s = m_saved_sessions.get(oldest)->get();
+    ScheduleTimer(m_expire_timer, (s->m_last_active_state + m_inactive_timeout) - std::chrono::steady_clock::now(),
+        timer_kind_t::EXPIRE);
+#endif
+}
+
+/*
+    Applies current saved settings on all class elements.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::ApplyMonitorSettings()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    volume_batch_scope batch(*this);
+
+    // Search current saved sessions and set exclude flag based on monitor settings.
+    for (auto it = m_saved_sessions.begin(); it != m_saved_sessions.end(); ++it)
+    {
+        // verdict still valid, filters did not change since it was taken.
+        if ((*it)->m_excluded_generation == m_filter_generation)
+            continue;
+        (*it)->m_excluded_generation = m_filter_generation;
+
+        bool excluded = isSessionExcluded((*it)->getPID(), (*it)->getInternedSID());
+        if (excluded)
+        {
+            dwprintf(L"\nExluding PID[%d] due to new config...\n", (*it)->getPID());
+            (*it)->m_excluded_flag = true;
+            (*it)->RestoreVolume(session_type::resume_t::NO_DELAY);
+        }
+        else
+            (*it)->m_excluded_flag = false;
+    }
+
+    if (m_auto_change_volume_flag)
+    {
+        // Update all session's volume
+        for (auto it = m_saved_sessions.begin(); it != m_saved_sessions.end(); ++it)
+        {
+            (*it)->ApplyVolumeSettings();
+        }
+    }
+}
+
+/*
+    Records a volume write while a volume_batch_scope is open, returns false if the caller must write it now.
+*/
+template <class Backend>
+bool BasicAudioMonitor<Backend>::QueueVolume(session_type* session, const float volume)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    if (m_volume_batch_depth == 0)
+        return false;
+
+    if (session->m_volume_command != no_volume_command)
+    {
+        m_volume_batch[session->m_volume_command].volume = volume; // last target wins
+    }
+    else
+    {
+        session->m_volume_command = static_cast<uint32_t>(m_volume_batch.size());
+        m_volume_batch.push_back(volume_command{ session, volume });
+    }
+
+    return true;
+}
+
+/*
+    Writes the pending batched volume of a single session now, if any.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::FlushVolume(session_type* session)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    if (session->m_volume_command == no_volume_command)
+        return;
+
+    volume_command& c = m_volume_batch[session->m_volume_command];
+    session->m_volume_command = no_volume_command;
+    c.session = nullptr;
+
+    if (Backend::is_open(session->m_handle))
+        session->m_hrStatus = WriteVolume(session, c.volume);
+}
+
+/*
+    Writes all batched volumes in one pass.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::SubmitVolumeBatch()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    for (const auto& c : m_volume_batch)
+    {
+        if (!c.session)
+            continue;
+
+        c.session->m_volume_command = no_volume_command;
+        if (Backend::is_open(c.session->m_handle))
+            c.session->m_hrStatus = WriteVolume(c.session, c.volume);
+    }
+
+    if (!m_volume_batch.empty())
+    {
+        dprintf("AudioMonitor::SubmitVolumeBatch() %u volume writes\n", (unsigned)m_volume_batch.size());
+    }
+
+    m_volume_batch.clear(); // keeps capacity for the next tick
+}
+
+/*
+    Every OS volume write of the monitor goes through here.
+*/
+template <class Backend>
+HRESULT BasicAudioMonitor<Backend>::WriteVolume(session_type* session, const float volume)
+{
+    m_volume_writes.fetch_add(1, std::memory_order_relaxed);
+    return Backend::set_volume(session->m_handle, volume);
+}
+
+/*
+    Registers a session ramp (already set up by RampVolume) and makes sure the ramp tick runs.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::AddRamp(session_type* session)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    if (session->m_ramp_index == no_ramp)
+    {
+        session->m_ramp_index = static_cast<uint32_t>(m_ramps.size());
+        m_ramps.push_back(session);
+    }
+
+    if (!m_timers.pending(m_ramp_timer))
+        ArmRampTimer();
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::CancelRamp(session_type* session)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    const uint32_t i = session->m_ramp_index;
+    if (i == no_ramp)
+        return;
+
+    // swap with last, order does not matter
+    m_ramps[i] = m_ramps.back();
+    m_ramps[i]->m_ramp_index = i;
+    m_ramps.pop_back();
+    session->m_ramp_index = no_ramp;
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::ArmRampTimer()
+{
+    ScheduleTimer(m_ramp_timer, m_settings.ramp_interval, timer_kind_t::RAMP);
+}
+
+/*
+    Advances all volume ramps, the only timer involved in ramping.
+
+    Runs every monitor_settings::ramp_interval while there are ramps in flight. Steps of one tick are written
+        in a single volume batch, capped to max_volume_writes per second, sessions left out this tick are
+        served first on the next one.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::RampTick()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    if (m_ramps.empty())
+        return;
+
+    size_t budget = std::numeric_limits<size_t>::max();
+    if (m_settings.max_volume_writes)
+    {
+        budget = static_cast<size_t>(
+            (static_cast<uint64_t>(m_settings.max_volume_writes) * m_settings.ramp_interval.count()) / 1000);
+        if (budget == 0)
+            budget = 1;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const size_t n = m_ramps.size();
+    const size_t first = m_ramp_cursor % n;
+    size_t next_first = first;
+
+    m_ramps_done.clear();
+    {
+        volume_batch_scope batch(*this);
+
+        for (size_t k = 0; k < n; ++k)
+        {
+            session_type* s = m_ramps[(first + k) % n];
+            const float v = s->RampValue(now);
+            const bool done = (now >= s->m_ramp_start + s->m_ramp_duration);
+
+            if (std::fabs(v - s->m_volume) >= 0.0001f)
+            {
+                if (budget == 0)
+                {
+                    m_volume_writes_throttled.fetch_add(1, std::memory_order_relaxed);
+                    continue;
+                }
+                budget--;
+                next_first = first + k + 1;
+                s->ChangeVolume(v);
+            }
+
+            if (done)
+                m_ramps_done.push_back(s);
+        }
+    }
+    m_ramp_cursor = next_first;
+
+    for (session_type* s : m_ramps_done)
+        CancelRamp(s);
+
+    if (!m_ramps.empty())
+        ArmRampTimer();
+}
+
+/*
+    Rewrites the journal on a reactor thread, record() asks for it once per compaction.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::CompactJournal()
+{
+    std::shared_ptr<volume_journal> journal(m_journal);
+    if (journal)
+        m_io->post([journal]() { journal->compact(); });
+}
+
+/*
+    (Re)schedules monitor timer 'h' to fire after 'delay', a pending one is replaced.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::ScheduleTimer(timer_handle& h, const std::chrono::steady_clock::duration delay,
+    const timer_kind_t kind, session_type* session)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    m_timers.cancel(h);
+    h = m_timers.schedule(std::chrono::steady_clock::now() + delay, monitor_timer{ kind, session });
+
+    ArmWheelTimer();
+}
+
+/*
+    Cancels a pending monitor timer, does nothing if it already fired. O(1), no asio involved.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::CancelTimer(timer_handle& h)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    m_timers.cancel(h);
+}
+
+/*
+    Makes sure the wheel timer wakes up no later than the next due slot of m_timers.
+
+    Cancelled timers are not unarmed, the wheel timer may wake up for nothing, that is cheaper
+        than rearming on every cancel (restores are cancelled far more often than they fire).
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::ArmWheelTimer()
+{
+    const std::chrono::steady_clock::time_point next = m_timers.next_due();
+    if ((next >= m_wheel_armed_at) || !m_strand || m_abort)
+        return;
+
+    if (!m_wheel_timer)
+        m_wheel_timer.reset(new boost::asio::steady_timer(*m_io));
+
+    // replaces any pending wait, its handler gets operation_aborted.
+    m_wheel_timer->expires_at(next);
+    m_handlers_pending.fetch_add(1);
+    m_wheel_timer->async_wait(m_strand->wrap([this](boost::system::error_code const& e)
+    {
+        WheelTick(e);
+        m_handlers_pending.fetch_sub(1);
+    }));
+    m_wheel_armed_at = next;
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::WheelTick(boost::system::error_code const& e)
+{
+    if (e == boost::asio::error::operation_aborted)
+        return;
+
+    if (e)
+        printf("ASIO ERROR AudioMonitor::WheelTick Timer: %s\n", e.message().c_str());
+
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    m_wheel_armed_at = std::chrono::steady_clock::time_point::max();
+    m_timers.advance(std::chrono::steady_clock::now(), [this](const monitor_timer& t) { OnTimer(t); });
+    ArmWheelTimer();
+}
+
+/*
+    Dispatches a due monitor timer, its handle is already stale here.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::OnTimer(const monitor_timer& t)
+{
+    switch (t.kind)
+    {
+    case timer_kind_t::RESTORE:
+        dprintf("AudioMonitor::OnTimer PID[%d] Wait Complete Restoring Volume...\n", t.session->getPID());
+        // Important: Send NO_DELAY always from here so we break the loop.
+        t.session->RestoreVolume(session_type::resume_t::NO_DELAY);
+        break;
+
+    case timer_kind_t::EXPIRE:
+        DeleteExpiredSessions();
+        break;
+
+    case timer_kind_t::RAMP:
+        RampTick();
+        break;
+
+    case timer_kind_t::RETIRE:
+        RetireTick();
+        break;
+    }
+}
+
+/*
+    Hands a backend callback over to the monitor thread, called from OS callback threads.
+
+    MSDN asks callbacks not to block, so the command is moved into a lock free ring instead of building
+        and posting an io_service handler per callback. Only the first command after a drain started
+        posts DrainCommands, the rest of a burst rides along with it.
+    If the ring is full the command is appended to an overflow list, and so is every command after it until
+        DrainCommands takes the list, which it runs after what is left in the ring, so commands keep callback order.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::PushCommand(monitor_command&& c)
+{
+    m_commands_pushed.fetch_add(1, std::memory_order_relaxed);
+
+    if (!m_commands_overflowed.load() && m_commands.try_push(std::move(c)))
+    {
+        if (!m_drain_pending.exchange(true))
+            Post([this]() { DrainCommands(); });
+        return;
+    }
+
+    m_command_overflows.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(m_overflow_mutex);
+        m_overflow.push_back(std::move(c));
+        m_commands_overflowed.store(true);
+    }
+    if (!m_drain_pending.exchange(true))
+        Post([this]() { DrainCommands(); });
+}
+
+/*
+    External volume changes (SndVol slider drags) come in storms, only the latest one matters.
+
+    Each session holds one "dirty + latest value" slot, the change that finds it clean queues a VOLUME_CHANGED
+        command, later ones only replace the value until the monitor thread takes it.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::PushVolumeChange(std::shared_ptr<session_type> session, float volume)
+{
+    m_volume_changes.fetch_add(1, std::memory_order_relaxed);
+
+    session->m_external_volume.store(volume);
+    if (session->m_external_volume_dirty.exchange(true))
+    {
+        m_volume_coalesced.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    PushCommand(monitor_command::volume_changed(std::move(session)));
+}
+
+/*
+    Runs every command in the ring and the overflow list, their volume writes go out in one batch.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::DrainCommands()
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    // commands pushed from now on post another drain, even if this one ends up running them.
+    m_drain_pending.store(false);
+
+    size_t n = 0;
+    {
+        volume_batch_scope batch(*this);
+
+        monitor_command c;
+        while (m_commands.try_pop(c))
+        {
+            RunCommand(c);
+            n++;
+        }
+
+        if (m_commands_overflowed.load())
+        {
+            // what is still in the ring was pushed before the overflow list, callbacks go back to the ring
+            //  as soon as the list is taken.
+            std::vector<monitor_command> commands;
+            {
+                std::lock_guard<std::mutex> lock(m_overflow_mutex);
+                while (m_commands.try_pop(c))
+                    commands.push_back(std::move(c));
+                std::move(m_overflow.begin(), m_overflow.end(), std::back_inserter(commands));
+                m_overflow.clear();
+                m_commands_overflowed.store(false);
+            }
+            for (monitor_command& o : commands)
+            {
+                RunCommand(o);
+                n++;
+            }
+        }
+    }
+
+    if (n)
+        m_command_batches.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class Backend>
+void BasicAudioMonitor<Backend>::RunCommand(monitor_command& c)
+{
+    Backend::run_command(m_manager, c.kind, [this, &c]()
+    {
+        switch (c.kind)
+        {
+        case command_t::SESSION_CREATED:
+            SaveSession(c.source, true);
+            break;
+        case command_t::STATE_CHANGED:
+            c.session->state_changed_callback_handler(c.state);
+            break;
+        case command_t::VOLUME_CHANGED:
+            // clean before reading, a change stored from now on queues another command.
+            c.session->m_external_volume_dirty.store(false);
+            c.session->UpdateDefaultVolume(c.session->m_external_volume.load());
+            break;
+        }
+    });
+}
+
+/*
+    Drops commands that will never run (monitor thread gone), releasing what they reference.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::DiscardCommands()
+{
+    monitor_command c;
+    while (m_commands.try_pop(c))
+    {
+        if (c.kind == command_t::SESSION_CREATED)
+            Backend::release_source(c.source);
+    }
+
+    std::lock_guard<std::mutex> lock(m_overflow_mutex);
+    for (monitor_command& o : m_overflow)
+    {
+        if (o.kind == command_t::SESSION_CREATED)
+            Backend::release_source(o.source);
+    }
+    m_overflow.clear();
+    m_commands_overflowed.store(false);
+}
+
+/*
+    Counters of backend callbacks handed to the monitor thread, for measurement.
+*/
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetCommandStats() const -> command_stats
+{
+    command_stats stats;
+    stats.commands = m_commands_pushed.load(std::memory_order_relaxed);
+    stats.batches = m_command_batches.load(std::memory_order_relaxed);
+    stats.overflows = m_command_overflows.load(std::memory_order_relaxed);
+    stats.volume_coalesced = m_volume_coalesced.load(); // before changes, a coalesced change is counted in both
+    stats.volume_changes = m_volume_changes.load();
+    stats.volume_applied = stats.volume_changes - stats.volume_coalesced;
+    return stats;
+}
+
+/*
+    Round trip of public calls marshalled to the monitor thread, for measurement.
+*/
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetSyncCallStats() const -> sync_call_stats
+{
+    sync_call_stats stats;
+    stats.calls = m_sync_latency.calls();
+    stats.total_ns = m_sync_latency.total_ns();
+    stats.max_ns = m_sync_latency.max_ns();
+    return stats;
+}
+
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetRefreshStats() const -> refresh_stats
+{
+    refresh_stats stats;
+    stats.refreshes = m_refreshes.load();
+    stats.listed = m_refresh_listed.load();
+    stats.added = m_refresh_added.load();
+    stats.vanished = m_refresh_vanished.load();
+    return stats;
+}
+
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetMigrationStats() const -> migration_stats
+{
+    migration_stats stats;
+    stats.migrations = m_migrations.load();
+    stats.ducks_carried = m_ducks_carried.load();
+    stats.retired = m_sessions_retired.load();
+    return stats;
+}
+
+/*
+    Counters of OS volume writes, for measurement.
+*/
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetVolumeWriteStats() const -> volume_write_stats
+{
+    volume_write_stats stats;
+    stats.writes = m_volume_writes.load(std::memory_order_relaxed);
+    stats.throttled = m_volume_writes_throttled.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/*
+    Return true if audio session is excluded from monitoring.
+*/
+template <class Backend>
+bool BasicAudioMonitor<Backend>::isSessionExcluded(const DWORD pid, const interned_wstring& sid)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    return m_filter.is_excluded(pid, sid);
+}
+
+/*
+    Application profile of a session SID, or profile_table::no_profile if its executable has none.
+*/
+template <class Backend>
+uint32_t BasicAudioMonitor<Backend>::FindProfile(const interned_wstring& sid) const
+{
+    if (m_profiles.empty())
+        return profile_table::no_profile;
+
+    return m_profiles.find(profile_table::process_name(sid.lower()));
+}
+
+template <class Backend>
+const session_settings& BasicAudioMonitor<Backend>::SessionSettings(const uint32_t profile) const
+{
+    return (profile == profile_table::no_profile) ? m_settings.ses_global_settings : m_profiles.settings(profile);
+}
+
+/*
+    Saves a New session in multimap (core method)
+
+    Group of session with different SIID (SessionInstanceIdentifier) but with the same SID (SessionIdentifier) are
+        grouped togheter on the same multimap key (SID).
+    See more notes inside.
+    Before adding the session it detects whanever this session is another instance of the same process (same SID)
+        and copies the default volume of the last changed session. We need to do this because if we dont, it will
+        take the changed(non user default) volume of the other SID session as default..
+
+    session_source pSessionControl  -> the new session to add.
+    bool unref  -> do we release pSessionControl inside this function or not? useful for async calls
+*/
+template <class Backend>
+HRESULT BasicAudioMonitor<Backend>::SaveSession(typename Backend::session_source pSessionControl, const bool unref)
+{
+    HRESULT hr = S_OK;
+
+    if (!pSessionControl)
+        return E_INVALIDARG;
+
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    session_info info;
+    CHECK_HR(hr = Backend::get_session_info(pSessionControl, info));
+
+    if (!info.system_sounds)
+    {
+        dwprintf(L"\n---Saving New Session: PID[%d]:\n", info.pid);
+
+        // interned once here, the session keeps both for its lifetime.
+        interned_wstring sid = string_pool::global().intern(info.sid);
+        interned_wstring siid = string_pool::global().intern(info.siid);
+
+        bool is_excluded = false;
+        bool excluded_cached = false;
+        uint32_t profile = profile_table::no_profile;
+        bool profile_found = false;
+
+        bool duplicate = false;
+
+        //  If a SID already exists, copy the default volume of the last changed session of the same SID.
+        //  As SndVol does: always copies the sound volume of the last changed session, try opening the same music
+        //      player 3 times, before the 3rd change volume to the second instance and then to the first, wait >5sec
+        //      and open the 3rd, SndVol will take the 1rst one volume. NOTE: Takes 5sec for SndVol to register last
+        //      volume of SID on the registry at least on win7.
+        //  Registry saves only SIDs so they overwrite each other, the last one takes precedence.
+        float last_sid_volume_fix = -1.0;
+        if (m_saved_sessions.find(siid.id()).valid())
+        {
+            dwprintf(L"AudioMonitor::SaveSession - Equal SIID detected, DUPLICATE discarting...\n");
+            duplicate = true;
+        }
+        else
+        {
+            // The SID group keeps its most recently touched session at hand.
+            slot_handle last_changed = m_saved_sessions.most_recent(sid.id());
+            if (!last_changed.valid())
+            {
+                // Left ducked by a run that died, or known from an earlier session of this run.
+                if (m_journal && m_journal->default_volume(sid, last_sid_volume_fix))
+                {
+                    dwprintf(L"AudioMonitor::SaveSession PID[%d] Journal default volume %.2f\n", info.pid,
+                        last_sid_volume_fix);
+                }
+            }
+            else
+            {
+                dprintf("AudioMonitor::SaveSession - Equal SID detected bucket_size=%llu\n",
+                    (unsigned long long)m_saved_sessions.group_size(m_saved_sessions.sid(last_changed)));
+
+                const std::shared_ptr<session_type>& spLastChanged = *m_saved_sessions.get(last_changed);
+                last_sid_volume_fix = spLastChanged->m_default_volume;
+                dwprintf(L"AudioMonitor::SaveSession PID[%d] Copying default volume of last session PID[%d] %.2f\n",
+                    info.pid, spLastChanged->getPID(), last_sid_volume_fix);
+
+                // Same SID, same executable and profile.
+                profile = spLastChanged->m_profile;
+                profile_found = true;
+
+                // Same SID, the name filters agree, reuse its verdict if pid filters agree too.
+                if ((spLastChanged->m_excluded_generation == m_filter_generation) &&
+                    m_filter.same_pid_verdict(info.pid, spLastChanged->getPID()))
+                {
+                    is_excluded = spLastChanged->m_excluded_flag;
+                    excluded_cached = true;
+                }
+            }
+        }
+
+        if (!duplicate)
+        {
+            if (!excluded_cached)
+                is_excluded = isSessionExcluded(info.pid, sid);
+            if (!profile_found)
+                profile = FindProfile(sid);
+
+            // Initialize the new AudioSession and store it.
+            std::shared_ptr<session_type> pAudioSession(new session_type(pSessionControl, info, sid, siid,
+                this->shared_from_this(), last_sid_volume_fix));
+
+            // if created succesfuly, finish updating status and save it.
+            if (!FAILED(pAudioSession->GetStatus()))
+            {
+                if (is_excluded)
+                    pAudioSession->m_excluded_flag = true;
+                pAudioSession->m_excluded_generation = m_filter_generation;
+                pAudioSession->m_profile = profile;
+                pAudioSession->m_journal = m_journal;
+
+#ifdef VO_ENABLE_EVENTS
+                // Enable events after constructor finishes so callbacks are queued in io_service.
+                pAudioSession->InitEvents();
+#endif
+                // Update new session's volume to sync with current settings
+                pAudioSession->ApplyVolumeSettings();
+
+                // Save session
+                pAudioSession->m_slot = m_saved_sessions.insert(sid.id(), siid.id(), pAudioSession);
+                pAudioSession->m_refresh_epoch = m_refresh_epoch;
+                pAudioSession->JournalState();
+                UpdateExpiry(pAudioSession.get());
+
+                if (m_carried_ducks)
+                    CarryDuck(pAudioSession.get());
+            }
+            else
+                wprintf(L"---AudioMonitor::SaveSession PID[%d] ERROR opening session\n", (int)info.pid);
+        }
+    }
+    else
+    {
+        dwprintf(L"---AudioMonitor::SaveSession PID[%d] skipped...\n", info.pid);
+    }
+
+done:
+    if (unref)
+        Backend::release_source(pSessionControl);
+
+    return hr;
+}
+
+/*
+    Releases, restores and deletes a single session from container
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::DeleteSession(std::shared_ptr<session_type> spAudioSession)
+{
+    std::lock_guard<std::recursive_mutex> guard(m_mutex);
+
+    std::shared_ptr<session_type>* saved = m_saved_sessions.get(spAudioSession->m_slot);
+    if (saved && (*saved == spAudioSession))
+    {
+        CancelTimer(spAudioSession->m_restore_timer);
+
+        spAudioSession->ShutdownSession();
+        m_saved_sessions.erase(spAudioSession->m_slot);
+    }
+}
+
+/*
+    Stops monitoring current sessions
+
+    First we stop events so new sessions cant come in
+    Then we set auto change volume flag false
+    Finally we delete all sessions, restoring default volume.
+    Now the class is at clean state ready for shutdown or new start.
+
+    TODO: error codes
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::Stop()
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::Stop, this);
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        if (m_current_status == monitor_status_t::STOPPED)
+        {
+            dwprintf(L"\n\t ---- AudioMonitor::Stop() Monitor already Stopped .... \n");
+            return 0;
+        }
+
+        // Locks saved sessions volume change.
+        m_auto_change_volume_flag = false;
+
+#ifdef VO_ENABLE_EVENTS
+        // First we stop new sessions from coming
+        ret = StopEvents();
+#endif
+
+        // Deletes all sessions
+        // This will trigger AudioSession destructors, restoring volume.
+        DeleteSessions();
+
+        dwprintf(L"\n\t ---- AudioMonitor::Stop() STOPPED .... \n\n");
+        m_current_status = monitor_status_t::STOPPED;
+    }
+
+    return static_cast<long>(ret);
+}
+
+#ifdef VO_ENABLE_EVENTS
+/*
+    Enables backend Events for new sessions
+
+    Registers the class for callbacks to receive notifications on new sessions.
+    NOTE: For this to work we need to release all our session references and "refresh" get current SndVol sessions
+        see AudioMonitor::RefreshSession & AudioMonitor::Start
+
+    TODO: do error codes.
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::InitEvents()
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::InitEvents, this);
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        // Events for adding new sessions
+        ret = Backend::register_notifications(m_manager, this->shared_from_this());
+        if (ret == S_OK)
+        {
+            dprintf("AudioMonitor::InitEvents() Init Sessions notification events completed.\n");
+        }
+        assert(SUCCEEDED(ret));
+    }
+
+    return static_cast<long>(ret);
+}
+
+/*
+    Disables backend Events for new sessions
+
+    Unregisters the class for callbacks to stop new session notifications.
+
+    TODO: do error codes.
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::StopEvents()
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::StopEvents, this);
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        // Stop new session notifications
+        ret = Backend::unregister_notifications(m_manager);
+        if (ret == S_OK)
+        {
+            dprintf("AudioMonitor::StopEvents() Stopped Sessions notification events.\n");
+        }
+        else
+        {
+            dprintf("AudioMonitor::StopEvents() Sessions notification events already stopped or no instanced.\n");
+        }
+    }
+
+    return static_cast<long>(ret);
+}
+#endif
+
+template <class Backend>
+long BasicAudioMonitor<Backend>::Pause()
+{
+    HRESULT ret = S_OK;
+
+#ifndef VO_ENABLE_EVENTS
+    ret = Stop();
+    return static_cast<long>(ret);
+#else
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::Pause, this);
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        if (m_current_status == monitor_status_t::STOPPED)
+        {
+            dwprintf(L"\n\t ---- AudioMonitor::Pause() Monitor already Stopped .... \n");
+            return 0;
+        }
+        if (m_current_status == monitor_status_t::PAUSED)
+        {
+            dwprintf(L"\n\t ---- AudioMonitor::Pause() Monitor already Paused .... \n");
+            return 0;
+        }
+
+        // Global class flag , volume reduction inactive
+        m_auto_change_volume_flag = false;
+
+        volume_batch_scope batch(*this);
+
+        // Restore Volume of all sessions currently monitored
+        for (auto it = m_saved_sessions.begin(); it != m_saved_sessions.end(); ++it)
+        {
+            (*it)->RestoreVolume();
+        }
+        for (auto& s : m_retired_sessions)
+            s->RestoreVolume();
+
+        dwprintf(L"\n\t ---- AudioMonitor::Pause  PAUSED .... \n\n");
+        m_current_status = monitor_status_t::PAUSED;
+    }
+#endif
+
+    return static_cast<long>(ret);
+}
+
+/*
+    Starts monitoring audio sessions to change volume based on settings.
+
+    Each time we Start the monitor from a Stop we refresh all current sessions (useful when not using events too)
+    We also unlock volume change flag, so events or settings can change monitored sessions volume.
+    Finally we automatically start applying settings on current audio sessions.
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::Start()
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::Start, this);
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        if (m_current_status == monitor_status_t::RUNNING)
+        {
+            dwprintf(L"\n\t ---- AudioMonitor::Start() Monitor already Running .... \n");
+            return 0;
+        }
+
+        // sessions saved by the refresh and the reapplied ones share a single pass of volume writes.
+        volume_batch_scope batch(*this);
+
+        if (m_current_status == monitor_status_t::STOPPED)
+        {
+            dwprintf(L"\n\t .... AudioMonitor::Start() STARTED ----\n\n");
+
+            // IMPORTANT:
+            // see http://msdn.microsoft.com/en-us/library/dd368281%28v=vs.85%29.aspx remarks point 5(five)
+            // we must use the enumerator first or we wont receive new session notifications.
+            ret = RefreshSessions(); // nothing saved after a Stop, adds every current session
+
+#ifdef VO_ENABLE_EVENTS
+            /* Now we enable new incoming sessions. */
+            ret = InitEvents();
+
+            WatchEndpoints();
+#endif
+        }
+
+        if (m_current_status == monitor_status_t::PAUSED)
+        {
+            dwprintf(L"\n\t .... AudioMonitor::Start() RESUMED ----\n\n");
+        }
+
+        // Signal reduce volume flag and apply volume change settings.
+        m_auto_change_volume_flag = true;
+
+        // Update all session's volume based on current settings
+        for (auto it = m_saved_sessions.begin(); it != m_saved_sessions.end(); ++it)
+        {
+            (*it)->ApplyVolumeSettings();
+        }
+
+        m_current_status = monitor_status_t::RUNNING;
+    }
+
+    return static_cast<long>(ret); // TODO: error codes
+}
+
+/*
+    Simple thread safe proxy, see AudioMonitor::RefreshSessions for more info.
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::Refresh()
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::Refresh, this);
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        if (m_current_status == monitor_status_t::STOPPED)
+            return 0; // nothing saved, Start enumerates
+
+        volume_batch_scope batch(*this);
+        ret = RefreshSessions();
+    }
+
+    return static_cast<long>(ret); // TODO: error codes
+}
+
+/*
+    Gets current config
+*/
+template <class Backend>
+vo::monitor_settings BasicAudioMonitor<Backend>::GetSettings()
+{
+    return *GetSettingsSnapshot();
+}
+
+/*
+    Current settings without a round trip to the monitor thread.
+
+    The snapshot is immutable and shared, keep it as long as needed, SetSettings publishes a new one.
+*/
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetSettingsSnapshot() const -> settings_snapshot
+{
+    return std::atomic_load(&m_settings_snapshot);
+}
+
+/*
+    Replaces the snapshot other threads read, call it after every m_settings change.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::PublishSettings()
+{
+    std::atomic_store(&m_settings_snapshot, settings_snapshot(std::make_shared<vo::monitor_settings>(m_settings)));
+    m_vol_reduction.store(m_settings.ses_global_settings.vol_reduction);
+}
+
+/*
+    Parses new config and applies it.
+
+    Settings will be modified when parsed if some values where incorrect.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::SetSettings(vo::monitor_settings& settings)
+{
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        detail::SYNC_CALL(*m_strand, m_sync_latency, &BasicAudioMonitor::SetSettings, this, std::ref(settings));
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return;
+
+        // compile pid and process name filters only if they changed, settings keep the user's spelling.
+        // a new generation invalidates every saved exclusion verdict.
+        if (!process_filter::same_filters(m_settings, settings))
+        {
+            m_filter = process_filter(settings, m_processid);
+            m_filter_generation++;
+        }
+
+        const bool profiles_changed = !profile_table::same_profiles(m_settings.ses_individual_settings,
+            settings.ses_individual_settings);
+
+        m_settings = settings;
+
+        ClampSessionSettings(m_settings.ses_global_settings);
+        for (auto& profile : m_settings.ses_individual_settings)
+            ClampSessionSettings(profile.second);
+
+        // compile application profiles only if they changed, saved sessions look theirs up again.
+        if (profiles_changed)
+        {
+            m_profiles = profile_table(m_settings.ses_individual_settings);
+            for (auto it = m_saved_sessions.begin(); it != m_saved_sessions.end(); ++it)
+                (*it)->m_profile = FindProfile((*it)->getInternedSID());
+        }
+
+        // ramps update at most every 5ms
+        if (m_settings.ramp_interval < std::chrono::milliseconds(5))
+            m_settings.ramp_interval = std::chrono::milliseconds(5);
+
+        // TODO: complete here when adding options, if compiler with different align is used, comment this line.
+#ifdef _DEBUG
+       // static_assert(sizeof(vo::monitor_settings) == 144, "Update AudioMonitor::SetSettings!"); // a reminder, read todo.
+#endif
+
+        PublishSettings();
+        ApplyMonitorSettings();
+
+        // return applied settings
+        settings = m_settings;
+
+        dprintf("AudioMonitor::SetSettings new settings parsed and applied.\n");
+    }
+
+}
+
+/*
+    Limits session settings to the values sessions can apply.
+*/
+template <class Backend>
+void BasicAudioMonitor<Backend>::ClampSessionSettings(session_settings& ses_settings)
+{
+    // If volume is in %, can be positive or negative.
+    //  example if vol reduction % is -50%, will actually increase volume by 50%!
+    // max limit for both is 1.0f
+    if (ses_settings.vol_reduction > 1.0f)
+        ses_settings.vol_reduction = 1.0f;
+    if (ses_settings.treat_vol_as_percentage)
+    {
+        // limit -1.0f to 1.0f
+        if (ses_settings.vol_reduction < -1.0f)
+            ses_settings.vol_reduction = -1.0f;
+    }
+    if (!ses_settings.treat_vol_as_percentage)
+    {
+        // limit 0.0f to 1.0f
+        if (ses_settings.vol_reduction < 0.0f)
+            ses_settings.vol_reduction = 0.0f;
+    }
+
+    if (ses_settings.vol_up_delay.count() < 0)
+        ses_settings.vol_up_delay = std::chrono::milliseconds::zero();
+    if (ses_settings.vol_attack.count() < 0)
+        ses_settings.vol_attack = std::chrono::milliseconds::zero();
+    if (ses_settings.vol_release.count() < 0)
+        ses_settings.vol_release = std::chrono::milliseconds::zero();
+}
+
+template <class Backend>
+float BasicAudioMonitor<Backend>::GetVolumeReductionLevel()
+{
+    if (m_current_status == monitor_status_t::INITERROR)
+        return -1.0f;
+
+    return m_vol_reduction.load();
+}
+
+/*
+    Sessions saved from now on record their default volume and duck state in 'journal' and take stranded
+        default volumes from it, see SaveSession. Null stops journaling new sessions.
+*/
+template <class Backend>
+long BasicAudioMonitor<Backend>::SetJournal(const std::shared_ptr<volume_journal>& journal)
+{
+    HRESULT ret = S_OK;
+
+    std::unique_lock<std::recursive_mutex> l(m_mutex, std::defer_lock);
+
+    if (!EnterMonitor(l))
+    {
+        ret = detail::SYNC_CALL_RET<long>(*m_strand, m_sync_latency, &BasicAudioMonitor::SetJournal, this,
+            std::cref(journal));
+    }
+    else
+    {
+        if (m_current_status == monitor_status_t::INITERROR)
+            return -1;
+
+        m_journal = journal;
+    }
+
+    return static_cast<long>(ret);
+}
+
+template <class Backend>
+auto BasicAudioMonitor<Backend>::GetStatus() -> monitor_status_t
+{
+    return m_current_status; // thread safe, std::atomic
+}
+
+} // end namespace vo
+
+#endif
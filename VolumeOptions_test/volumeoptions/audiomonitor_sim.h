@@ -0,0 +1,271 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    In memory session backend.
+
+    Simulated endpoints and sessions driven from code instead of SndVol, callbacks are posted to the
+        monitor thread exactly like the WASAPI ones so the whole core runs unchanged.
+    Used for tests, benchmarks and to build VolumeOptions on non Windows platforms.
+*/
+
+#ifndef VO_AUDIOMONITOR_SIM_H
+#define VO_AUDIOMONITOR_SIM_H
+
+#include "../volumeoptions/audiomonitor.h"
+#include "../volumeoptions/endpoint_manager.h"
+
+#include <vector>
+
+namespace vo {
+
+struct SimSessionBackend;
+class SimCallbackProxy;
+
+/*
+    A simulated SndVol session, shared between the driver and the monitor.
+*/
+struct SimAudioSessionControl
+{
+    SimAudioSessionControl(DWORD _pid, const std::wstring& _sid, const std::wstring& _siid, float _volume,
+        session_state_t _state, bool _system_sounds)
+        : pid(_pid)
+        , sid(_sid)
+        , siid(_siid)
+        , system_sounds(_system_sounds)
+        , volume(_volume)
+        , state(_state)
+        , volume_writes(0)
+    {}
+
+    const DWORD pid;
+    const std::wstring sid;
+    const std::wstring siid;
+    const bool system_sounds;
+
+    std::atomic<float> volume;
+    std::atomic<session_state_t> state;
+    std::atomic<uint64_t> volume_writes; // volume changes made by the monitor, not by the driver.
+
+    // registered session events, if any.
+    std::mutex events_mutex;
+    std::weak_ptr<BasicAudioSession<SimSessionBackend>> events_session;
+    std::weak_ptr<BasicAudioMonitor<SimSessionBackend>> events_monitor;
+};
+
+/*
+    Monitor handlers reached through simulated callbacks, for instrumentation.
+*/
+enum class sim_handler_t { SAVE_SESSION, STATE_CHANGED, UPDATE_DEFAULT_VOLUME, EXPIRE_SESSIONS, COUNT };
+
+// Called on the monitor thread after each handler with its execution time.
+typedef std::function<void(sim_handler_t, std::chrono::steady_clock::duration)> sim_handler_observer;
+
+/*
+    A simulated audio endpoint with its own session list.
+
+    Endpoints live in a static registry keyed by device id, L"" always names the default one.
+    Adding, removing and changing the default endpoint is reported to endpoint watchers like
+        IMMNotificationClient does, on the calling thread.
+    All driver methods are thread safe and never block on the monitor.
+*/
+class SimAudioEndpoint
+{
+public:
+    typedef std::shared_ptr<SimAudioSessionControl> session_ptr;
+
+    SimAudioEndpoint(const std::wstring& id, const std::wstring& name);
+
+    static std::shared_ptr<SimAudioEndpoint> add_endpoint(const std::wstring& id, const std::wstring& name);
+    static void remove_endpoint(const std::wstring& id); // a removed default falls back to the simulated speakers
+    static std::shared_ptr<SimAudioEndpoint> get_endpoint(const std::wstring& id = L"");
+    static std::vector<std::shared_ptr<SimAudioEndpoint>> endpoints();
+    static bool set_default_endpoint(const std::wstring& id); // false if there is no such endpoint
+    static std::wstring default_endpoint_id();
+
+    std::wstring id() const { return m_id; }
+    std::wstring name() const { return m_name; }
+
+    // Driver, simulates what applications and the user do on SndVol.
+    session_ptr add_session(DWORD pid, const std::wstring& sid, float volume = 1.0f, bool active = true,
+        bool system_sounds = false);
+    void set_session_state(const session_ptr& s, session_state_t state);
+    void set_session_volume(const session_ptr& s, float volume); // external (user) volume change
+    void remove_session(const session_ptr& s);
+    std::vector<session_ptr> get_sessions() const;
+
+    // Runs the listening monitor expiry sweep as if 'time_skew' had passed.
+    void expire_sessions(std::chrono::steady_clock::duration time_skew = std::chrono::steady_clock::duration::zero());
+
+    // Commands report to the observer set when they run, expire_sessions to the one set when it was called.
+    void set_handler_observer(const sim_handler_observer& observer);
+
+private:
+    friend struct SimSessionBackend;
+
+    std::shared_ptr<const sim_handler_observer> get_observer() const;
+
+    const std::wstring m_id;
+    const std::wstring m_name;
+
+    mutable std::mutex m_mutex;
+    std::vector<session_ptr> m_sessions;
+    std::weak_ptr<BasicAudioMonitor<SimSessionBackend>> m_notifications; // new session listener
+    std::shared_ptr<const sim_handler_observer> m_observer;
+    uint64_t m_next_instance;
+
+    static void notify(endpoint_event_t e, const std::wstring& id);
+
+    static std::mutex m_registry_mutex;
+    static std::map<std::wstring, std::shared_ptr<SimAudioEndpoint>> m_registry;
+    static std::wstring m_default_id;
+    static std::map<uint64_t, endpoint_listener> m_watchers;
+    static uint64_t m_next_watcher;
+};
+
+/*
+    Session backend policy over SimAudioEndpoint, see audiomonitor.h for requirements.
+*/
+struct SimSessionBackend
+{
+    typedef std::shared_ptr<SimAudioSessionControl> session_source;
+
+    struct session_handle
+    {
+        std::shared_ptr<SimAudioSessionControl> control;
+        bool events;
+
+        session_handle() : events(false) {}
+    };
+
+    struct manager_handle
+    {
+        std::shared_ptr<SimAudioEndpoint> endpoint;
+        bool notifications;
+
+        manager_handle() : notifications(false) {}
+    };
+
+    struct endpoint_watch
+    {
+        uint64_t watcher; // SimAudioEndpoint watcher id, 0 if not watching
+
+        endpoint_watch() : watcher(0) {}
+    };
+
+    typedef SimCallbackProxy callback_proxy;
+
+    static const DWORD default_endpoint_state_mask = 1;
+
+    typedef BasicAudioSession<SimSessionBackend> session_type;
+    typedef BasicAudioMonitor<SimSessionBackend> monitor_type;
+
+    // Endpoint
+    static void thread_init() {}
+    static DWORD current_process_id();
+    static HRESULT get_endpoints_info(std::map<std::wstring, std::wstring>& audio_endpoints, DWORD dwStateMask);
+    static HRESULT open_manager(manager_handle& m, std::wstring& device_id);
+    static void close_manager(manager_handle& m);
+    static bool manager_ready(const manager_handle& m) { return m.endpoint != nullptr; }
+    static HRESULT register_notifications(manager_handle& m, const std::weak_ptr<monitor_type>& wpAudioMonitor);
+    static HRESULT unregister_notifications(manager_handle& m);
+    static HRESULT enumerate_sessions(manager_handle& m, const std::function<void(session_source)>& f);
+    static HRESULT watch_endpoints(endpoint_watch& w, const endpoint_listener& f);
+    static void unwatch_endpoints(endpoint_watch& w);
+
+    // Session
+    static HRESULT get_session_info(const session_source& s, session_info& info);
+    static HRESULT get_session_instance_id(const session_source& s, std::wstring& siid);
+    static void release_source(const session_source&) {}
+    static HRESULT open_session(session_handle& h, const session_source& s);
+    static void close_session(session_handle& h) { h.control.reset(); }
+    static bool is_open(const session_handle& h) { return h.control != nullptr; }
+    static HRESULT register_session_events(session_handle& h, const std::weak_ptr<session_type>& wpAudioSession,
+        const std::weak_ptr<monitor_type>& wpAudioMonitor);
+    static HRESULT unregister_session_events(session_handle& h);
+    static HRESULT get_state(const session_handle& h, session_state_t& state)
+    {
+        state = h.control->state.load();
+        return S_OK;
+    }
+    static HRESULT get_volume(const session_handle& h, float& volume)
+    {
+        volume = h.control->volume.load();
+        return S_OK;
+    }
+    static HRESULT set_volume(session_handle& h, const float volume)
+    {
+        h.control->volume.store(volume);
+        h.control->volume_writes++;
+        return S_OK;
+    }
+    static void settle_new_session() {}
+
+    // Commands, reported to the endpoint handler observer.
+    template <class F>
+    static void run_command(const manager_handle& m, command_t command, F&& f)
+    {
+        std::shared_ptr<const sim_handler_observer> observer;
+        if (m.endpoint)
+            observer = m.endpoint->get_observer();
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        if (observer)
+            (*observer)(handler_of(command), std::chrono::steady_clock::now() - start);
+    }
+    static sim_handler_t handler_of(command_t command)
+    {
+        switch (command)
+        {
+        case command_t::SESSION_CREATED: return sim_handler_t::SAVE_SESSION;
+        case command_t::STATE_CHANGED: return sim_handler_t::STATE_CHANGED;
+        default: return sim_handler_t::UPDATE_DEFAULT_VOLUME;
+        }
+    }
+};
+
+extern template class BasicAudioSession<SimSessionBackend>;
+extern template class BasicAudioMonitor<SimSessionBackend>;
+
+typedef BasicAudioSession<SimSessionBackend> SimAudioSession;
+typedef BasicAudioMonitor<SimSessionBackend> SimAudioMonitor;
+typedef BasicEndpointManager<SimSessionBackend> SimEndpointManager;
+
+#ifndef _WIN32
+// No SndVol here, the simulated backend is the only one.
+typedef SimAudioSession AudioSession;
+typedef SimAudioMonitor AudioMonitor;
+typedef SimEndpointManager EndpointManager;
+#endif
+
+} // end namespace vo
+
+#endif
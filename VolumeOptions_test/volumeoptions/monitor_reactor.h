@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Shared reactor for AudioMonitors.
+
+    One io_service run by a small fixed pool of threads. Every monitor created on it serializes its handlers
+        on its own strand, monitoring N endpoints costs N strands instead of N threads and N idle io_services.
+    A monitor created without a reactor gets a private one with a single thread.
+*/
+
+#ifndef VO_MONITOR_REACTOR_H
+#define VO_MONITOR_REACTOR_H
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace vo {
+
+class monitor_reactor
+{
+public:
+    // thread_init runs first on every pool thread (backend thread state, COM), see BasicAudioMonitor::CreateReactor.
+    explicit monitor_reactor(unsigned threads, const std::function<void()>& thread_init = std::function<void()>())
+        : m_io(std::make_shared<boost::asio::io_service>())
+        , m_work(new boost::asio::io_service::work(*m_io))
+    {
+        threads = (std::max)(threads, 1u);
+        for (unsigned i = 0; i < threads; ++i)
+            m_threads.emplace_back(&monitor_reactor::run, m_io, thread_init);
+    }
+
+    monitor_reactor(const monitor_reactor&) = delete;
+    monitor_reactor& operator=(const monitor_reactor&) = delete;
+
+    /*
+        Monitors keep their reactor alive, the last one released stops and joins the pool.
+        Handlers still queued are dropped, monitors wait for theirs before letting it go.
+    */
+    ~monitor_reactor()
+    {
+        m_work.reset();
+        m_io->stop();
+        for (auto& t : m_threads)
+        {
+            if (t.get_id() == std::this_thread::get_id())
+                t.detach(); // released from one of its own handlers, run() only touches its own io_service copy.
+            else if (t.joinable())
+                t.join();
+        }
+    }
+
+    const std::shared_ptr<boost::asio::io_service>& get_io() const { return m_io; }
+    size_t size() const { return m_threads.size(); }
+
+private:
+    static void run(std::shared_ptr<boost::asio::io_service> io, std::function<void()> thread_init)
+    {
+        if (thread_init)
+            thread_init();
+
+        while (!io->stopped())
+        {
+            boost::system::error_code ec;
+            io->run(ec);
+            if (ec)
+            {
+                std::cerr << "[ERROR] Asio msg: " << ec.message() << std::endl;
+            }
+        }
+    }
+
+    std::shared_ptr<boost::asio::io_service> m_io;
+    std::unique_ptr<boost::asio::io_service::work> m_work;
+    std::vector<std::thread> m_threads;
+};
+
+} // end namespace vo
+
+#endif
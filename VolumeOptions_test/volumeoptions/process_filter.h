@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Compiled session exclusion filters.
+
+    AudioMonitor compiles its process filters once per SetSettings, each session SID is then classified
+        in a single pass over its lowercase form no matter how many process names are configured.
+*/
+
+#ifndef VO_PROCESS_FILTER_H
+#define VO_PROCESS_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../volumeoptions/vo_settings.h"
+#include "../volumeoptions/string_pool.h"
+
+namespace vo {
+
+/*
+    Aho-Corasick automaton answering if a text contains any of its patterns.
+
+    Compiled into a full transition table over the characters present in the patterns (every other
+        character shares one class), so a search is one table lookup per text character.
+    Patterns and searched text must already be case folded (fold_case).
+*/
+class multi_pattern_matcher
+{
+public:
+    multi_pattern_matcher(); // matches nothing
+    explicit multi_pattern_matcher(const std::vector<std::wstring>& patterns);
+
+    bool empty() const { return !m_match_all && (m_accept.size() <= 1); }
+    bool search(const std::wstring& text) const;
+
+    size_t states() const { return m_accept.size(); }
+
+private:
+    uint32_t char_class(wchar_t c) const;
+
+    bool m_match_all; // an empty pattern is found in every text
+    uint32_t m_classes;
+    uint32_t m_ascii_class[128];
+    std::vector<std::pair<wchar_t, uint32_t>> m_wide_class; // sorted by character
+    std::vector<uint32_t> m_delta;  // state * m_classes + class -> state
+    std::vector<uint8_t> m_accept;  // by state, a pattern ends here
+};
+
+/*
+    monitor_settings pid and process name filters, compiled.
+
+    Same verdicts as the settings they were built from:
+        own process is excluded first if exclude_own_process is set, sessions without SID are never excluded,
+        blacklist mode excludes listed pids or SIDs containing a listed name, whitelist mode excludes the rest.
+*/
+class process_filter
+{
+public:
+    process_filter(); // excludes nothing
+    process_filter(const monitor_settings& settings, const unsigned long own_pid);
+
+    bool is_excluded(const unsigned long pid, const interned_wstring& sid) const;
+
+    // true if sessions of both pids with the same SID always get the same verdict.
+    bool same_pid_verdict(const unsigned long pid_a, const unsigned long pid_b) const;
+
+    // true if both settings compile to the same filter.
+    static bool same_filters(const monitor_settings& a, const monitor_settings& b);
+
+private:
+    bool has_pid(const unsigned long pid) const;
+
+    bool m_exclude_own_process;
+    unsigned long m_own_pid;
+    bool m_use_included_filter;
+    std::vector<unsigned long> m_pids; // sorted, pids of the active list
+    multi_pattern_matcher m_names; // process names of the active list
+};
+
+} // end namespace vo
+
+#endif
@@ -0,0 +1,367 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    AudioMonitor saved sessions storage.
+
+    Sessions are stored in a flat slot vector keyed by the string_pool ids of their SID and SIID,
+        so lookups never hash a wide string and sweeps walk contiguous memory.
+    Sessions of the same SID (instances of the same process) form a group, a recency ordered list
+        threaded through the slots, its head is the most recently touched member.
+    Inactive sessions are also threaded in the order they went inactive, the expiry index.
+*/
+
+#ifndef VO_SESSION_TABLE_H
+#define VO_SESSION_TABLE_H
+
+#include <cassert>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "../volumeoptions/string_pool.h"
+
+namespace vo {
+
+/*
+    Stable reference to a session_table slot, stale handles (erased slots) never match.
+*/
+struct slot_handle
+{
+    slot_handle() : index(0xFFFFFFFF), generation(0) {}
+    slot_handle(uint32_t i, uint32_t g) : index(i), generation(g) {}
+
+    bool valid() const { return index != 0xFFFFFFFF; }
+    bool operator==(const slot_handle& o) const { return (index == o.index) && (generation == o.generation); }
+    bool operator!=(const slot_handle& o) const { return !(*this == o); }
+
+    uint32_t index;
+    uint32_t generation;
+};
+
+/*
+    Flat slot map of T keyed by interned SID/SIID ids, SIIDs are unique, SIDs group sessions.
+    The table does not reference the ids, whoever inserts must keep the strings interned while stored.
+
+    Every operation is O(1) except iteration, which is linear on the number of slots.
+    Not thread safe, AudioMonitor uses it only from its own thread.
+*/
+template <class T>
+class session_table
+{
+    enum : uint32_t { npos = 0xFFFFFFFF };
+
+    struct slot
+    {
+        T value;
+        string_id_t sid;
+        string_id_t siid;
+        uint32_t generation;
+        uint32_t prev; // group recency list, towards most recent
+        uint32_t next; // group recency list, towards least recent
+        uint32_t idle_prev; // inactive list, towards oldest
+        uint32_t idle_next; // inactive list, towards newest
+        bool used;
+        bool idle;
+    };
+
+    struct group
+    {
+        uint32_t head; // most recently touched member
+        uint32_t count;
+    };
+
+public:
+    session_table() : m_idle_head(npos), m_idle_tail(npos), m_size(0) {}
+
+    /* iterates used slots in slot order */
+    template <class table_t, class value_t>
+    class basic_iterator
+    {
+    public:
+        basic_iterator(table_t* t, uint32_t i) : m_t(t), m_i(i) { skip(); }
+
+        value_t& operator*() const { return m_t->m_slots[m_i].value; }
+        value_t* operator->() const { return &m_t->m_slots[m_i].value; }
+        basic_iterator& operator++() { ++m_i; skip(); return *this; }
+        bool operator==(const basic_iterator& o) const { return m_i == o.m_i; }
+        bool operator!=(const basic_iterator& o) const { return m_i != o.m_i; }
+
+        slot_handle handle() const { return slot_handle(m_i, m_t->m_slots[m_i].generation); }
+
+    private:
+        void skip()
+        {
+            while (m_i < m_t->m_slots.size() && !m_t->m_slots[m_i].used)
+                ++m_i;
+        }
+
+        table_t* m_t;
+        uint32_t m_i;
+    };
+    typedef basic_iterator<session_table, T> iterator;
+    typedef basic_iterator<const session_table, const T> const_iterator;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, static_cast<uint32_t>(m_slots.size())); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, static_cast<uint32_t>(m_slots.size())); }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    /*
+        Inserts a new session, siid must not be in the table.
+        The new session becomes the most recently touched of its SID group.
+    */
+    slot_handle insert(string_id_t sid, string_id_t siid, T value)
+    {
+        assert(!find(siid).valid());
+
+        uint32_t i;
+        if (!m_free.empty())
+        {
+            i = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            i = static_cast<uint32_t>(m_slots.size());
+            m_slots.push_back(slot{ T(), invalid_string_id, invalid_string_id, 0, npos, npos, npos, npos, false, false });
+        }
+
+        slot& s = m_slots[i];
+        s.value = std::move(value);
+        s.sid = sid;
+        s.siid = siid;
+        s.used = true;
+
+        if (m_by_siid.size() <= siid)
+            m_by_siid.resize(siid + 1, npos);
+        m_by_siid[siid] = i;
+
+        if (m_groups.size() <= sid)
+            m_groups.resize(sid + 1, group{ npos, 0 });
+        m_groups[sid].count++;
+        link_front(i);
+
+        m_size++;
+
+        return slot_handle(i, s.generation);
+    }
+
+    /*
+        Returns false if h was stale.
+        The value is destroyed once the slot is released, so its destructor may use the table (h is already stale).
+    */
+    bool erase(slot_handle h)
+    {
+        if (!get(h))
+            return false;
+
+        slot& s = m_slots[h.index];
+        unlink(h.index);
+        unlink_idle(h.index);
+        m_groups[s.sid].count--;
+        m_by_siid[s.siid] = npos;
+
+        T value(std::move(s.value));
+        s.value = T();
+        s.used = false;
+        s.generation++;
+        s.sid = s.siid = invalid_string_id;
+        m_free.push_back(h.index);
+        m_size--;
+
+        return true;
+    }
+
+    /*
+        Like erase, values are destroyed after the table is already empty.
+        Slots are kept with their generation bumped, handles held past clear() stay stale.
+    */
+    void clear()
+    {
+        std::vector<T> values;
+        values.reserve(m_size);
+        m_free.clear();
+        for (uint32_t i = static_cast<uint32_t>(m_slots.size()); i-- > 0;)
+        {
+            slot& s = m_slots[i];
+            if (s.used)
+            {
+                values.push_back(std::move(s.value));
+                s.value = T();
+                s.used = false;
+                s.generation++;
+                s.sid = s.siid = invalid_string_id;
+            }
+            s.prev = s.next = s.idle_prev = s.idle_next = npos;
+            s.idle = false;
+            m_free.push_back(i); // lowest slot is reused first
+        }
+        m_groups.clear();
+        m_by_siid.clear();
+        m_idle_head = m_idle_tail = npos;
+        m_size = 0;
+    }
+
+    T* get(slot_handle h)
+    {
+        if (h.index >= m_slots.size())
+            return nullptr;
+        slot& s = m_slots[h.index];
+        return (s.used && (s.generation == h.generation)) ? &s.value : nullptr;
+    }
+
+    string_id_t sid(slot_handle h) const { return m_slots[h.index].sid; }
+    string_id_t siid(slot_handle h) const { return m_slots[h.index].siid; }
+
+    /* session with this SIID or an invalid handle */
+    slot_handle find(string_id_t siid) const
+    {
+        if ((siid >= m_by_siid.size()) || (m_by_siid[siid] == npos))
+            return slot_handle();
+        uint32_t i = m_by_siid[siid];
+        return slot_handle(i, m_slots[i].generation);
+    }
+
+    size_t group_size(string_id_t sid) const
+    {
+        return (sid < m_groups.size()) ? m_groups[sid].count : 0;
+    }
+
+    /* most recently touched session of the SID group or an invalid handle */
+    slot_handle most_recent(string_id_t sid) const
+    {
+        if ((sid >= m_groups.size()) || (m_groups[sid].head == npos))
+            return slot_handle();
+        uint32_t i = m_groups[sid].head;
+        return slot_handle(i, m_slots[i].generation);
+    }
+
+    /* marks the session as the most recently touched of its group */
+    void touch(slot_handle h)
+    {
+        if (!get(h) || (m_groups[m_slots[h.index].sid].head == h.index))
+            return;
+        unlink(h.index);
+        link_front(h.index);
+    }
+
+    /*
+        Moves the session to the newest end of the inactive list, call it when it goes inactive.
+        With a constant inactive timeout the oldest one is always the next to expire.
+    */
+    void push_inactive(slot_handle h)
+    {
+        if (!get(h))
+            return;
+        unlink_idle(h.index);
+
+        slot& s = m_slots[h.index];
+        s.idle = true;
+        s.idle_prev = m_idle_tail;
+        s.idle_next = npos;
+        if (m_idle_tail != npos)
+            m_slots[m_idle_tail].idle_next = h.index;
+        else
+            m_idle_head = h.index;
+        m_idle_tail = h.index;
+    }
+
+    /* the session is active again */
+    void remove_inactive(slot_handle h)
+    {
+        if (get(h))
+            unlink_idle(h.index);
+    }
+
+    /* session inactive for the longest time or an invalid handle */
+    slot_handle oldest_inactive() const
+    {
+        if (m_idle_head == npos)
+            return slot_handle();
+        return slot_handle(m_idle_head, m_slots[m_idle_head].generation);
+    }
+
+private:
+    void link_front(uint32_t i)
+    {
+        slot& s = m_slots[i];
+        group& g = m_groups[s.sid];
+        s.prev = npos;
+        s.next = g.head;
+        if (g.head != npos)
+            m_slots[g.head].prev = i;
+        g.head = i;
+    }
+
+    void unlink(uint32_t i)
+    {
+        slot& s = m_slots[i];
+        if (s.prev != npos)
+            m_slots[s.prev].next = s.next;
+        else
+            m_groups[s.sid].head = s.next;
+        if (s.next != npos)
+            m_slots[s.next].prev = s.prev;
+        s.prev = s.next = npos;
+    }
+
+    void unlink_idle(uint32_t i)
+    {
+        slot& s = m_slots[i];
+        if (!s.idle)
+            return;
+        if (s.idle_prev != npos)
+            m_slots[s.idle_prev].idle_next = s.idle_next;
+        else
+            m_idle_head = s.idle_next;
+        if (s.idle_next != npos)
+            m_slots[s.idle_next].idle_prev = s.idle_prev;
+        else
+            m_idle_tail = s.idle_prev;
+        s.idle_prev = s.idle_next = npos;
+        s.idle = false;
+    }
+
+    std::vector<slot> m_slots;
+    std::vector<uint32_t> m_free;
+    std::vector<group> m_groups;      // indexed by SID id
+    std::vector<uint32_t> m_by_siid;  // indexed by SIID id -> slot
+    uint32_t m_idle_head; // oldest inactive
+    uint32_t m_idle_tail; // newest inactive
+    size_t m_size;
+};
+
+} // end namespace vo
+
+#endif
@@ -40,6 +40,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace vo {
 
+// Volume ramp shape, LINEAR on the volume scalar, DB linear on decibels (sounds even to the ear).
+enum class ramp_curve_t { LINEAR, DB };
+
 // SndVol Library Session settings
 struct session_settings
 {
@@ -48,6 +51,9 @@ struct session_settings
         , treat_vol_as_percentage(true)
         , vol_up_delay(400)
         , vol_reduction(0.5f)
+        , vol_attack(0)
+        , vol_release(0)
+        , ramp_curve(ramp_curve_t::DB)
     {}
 
     // Session settings
@@ -55,6 +61,9 @@ struct session_settings
     bool treat_vol_as_percentage;
     float vol_reduction;
     std::chrono::milliseconds vol_up_delay; // delay to restore default volume.
+    std::chrono::milliseconds vol_attack;   // ramp time to reduced volume, 0 = instant.
+    std::chrono::milliseconds vol_release;  // ramp time back to default volume (after vol_up_delay), 0 = instant.
+    ramp_curve_t ramp_curve;
 };
 
 
@@ -64,6 +73,8 @@ struct monitor_settings
     monitor_settings()
         : exclude_own_process(true)
         , use_included_filter(false)
+        , ramp_interval(20)
+        , max_volume_writes(500)
     {}
 
     std::set<unsigned long> excluded_pids;		// process id blacklist
@@ -74,7 +85,11 @@ struct monitor_settings
     bool use_included_filter; // cant use both, blacklist or whitelist
     bool exclude_own_process;
 
-   // std::map<std::wstring, session_settings> ses_individual_settings; // TODO
+    std::chrono::milliseconds ramp_interval; // volume ramps update period, shared by all sessions.
+    unsigned max_volume_writes; // ramp volume writes per second cap for the whole monitor, 0 = no cap.
+
+    // per application settings keyed by executable name (case insensitive), used instead of ses_global_settings.
+    std::map<std::wstring, session_settings> ses_individual_settings;
 
     session_settings ses_global_settings;
 };
@@ -83,6 +98,9 @@ struct volume_options_settings
 {
     volume_options_settings()
         : exclude_own_client(true)
+        , duck_delay(0)
+        , min_duck_time(0)
+        , release_hold(0)
     {}
 
     // TODO: remove monitor_settings and make vol_reduction shortcuts
@@ -90,6 +108,11 @@ struct volume_options_settings
 
     // add extra settings for your inteface.
     bool exclude_own_client;
+
+    // talk hysteresis (talk_hysteresis.h), all 0 = duck and release on every talk status change.
+    std::chrono::milliseconds duck_delay;    // talk time before ducking
+    std::chrono::milliseconds min_duck_time; // minimum time ducked
+    std::chrono::milliseconds release_hold;  // silence time before releasing
 };
 
 } // end namespace vo
@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2014, Paul Dolcet
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+    * Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+
+    * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+    * Neither the name of VolumeOptions nor the names of its
+    contributors may be used to endorse or promote products derived from
+    this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+    Crash safe journal of user default volumes.
+
+    AudioSession::m_default_volume only lives in memory, if the process dies while ducked, sessions stay
+        at the reduced volume. The journal keeps the last (SID, default volume, ducked) of every SID in an
+        append only memory mapped file, the OS writes it back even if the process dies right after, the
+        hot path is a memcpy, never a flush.
+    The next run replays it, SIDs left ducked are stranded and seed the default volume of their sessions
+        (see AudioMonitor::SaveSession), superseded records are dropped by compact(), off the hot path.
+
+    File: header, then records { size, checksum, default volume, flags, SID length, SID (native wchar_t) }
+        aligned to 4 bytes. Replay stops at the first incomplete or corrupt record.
+*/
+
+#ifndef VO_VOLUME_JOURNAL_H
+#define VO_VOLUME_JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "../volumeoptions/string_pool.h"
+
+namespace vo {
+
+/*
+    Thread safe, shared by every monitor of the process (SIDs include the endpoint id).
+*/
+class volume_journal
+{
+public:
+    volume_journal();
+    ~volume_journal();
+    volume_journal(const volume_journal&) = delete;
+    volume_journal& operator=(const volume_journal&) = delete;
+
+    /*
+        Opens or creates the journal at 'path' and replays it, false if it can not be mapped.
+        Call once before use, an unopened journal only keeps its state in memory.
+    */
+    bool open(const std::string& path);
+    bool is_open() const;
+
+    /*
+        A session of 'sid' has this default volume and went ducked (+1), restored (-1) or neither (0).
+        Appends a record only if the SID state changed. Returns true once when compact() is due,
+            the caller runs it off the hot path.
+    */
+    bool record(const interned_wstring& sid, float default_volume, int ducked_delta);
+
+    /*
+        Default volume to seed new sessions of 'sid' with: the one the previous run left ducked (stranded),
+            or the last one recorded in this run. false if neither, the OS volume is the best guess then.
+    */
+    bool default_volume(const interned_wstring& sid, float& volume) const;
+
+    /*
+        Rewrites the journal with one record per SID, appends made meanwhile are carried over.
+    */
+    bool compact();
+
+    struct journal_stats
+    {
+        uint64_t records;     // records appended since open
+        uint64_t bytes;       // journal size in use
+        uint64_t live;        // SIDs known
+        uint64_t stranded;    // SIDs the previous run left ducked, not seen yet
+        uint64_t compactions;
+    };
+    journal_stats get_stats() const;
+
+private:
+    struct sid_state
+    {
+        float default_volume;
+        uint32_t ducked;  // sessions of the SID ducked now
+        bool stranded;    // left ducked by the previous run, cleared by the first record of this run
+        bool recorded;    // recorded by this run
+        bool dirty;       // changed while compact() writes its snapshot
+    };
+    typedef std::unordered_map<interned_wstring, sid_state> state_map;
+
+    struct mapping; // platform file mapping, see volume_journal.cpp
+
+    void replay();
+    bool append(const std::wstring& sid, const sid_state& s);
+    bool reserve(size_t bytes);
+
+    enum : uint32_t { min_size = 64 * 1024, compact_ratio = 4 };
+
+    mutable std::mutex m_mutex;
+    std::string m_path;
+    mapping* m_map;     // null if not open
+    size_t m_tail;      // end of the last valid record
+    size_t m_live_bytes; // size of a compacted journal, one record per SID
+    state_map m_state;
+    bool m_compacting;
+    bool m_compaction_due; // record() asked for a compact() that did not run yet
+
+    uint64_t m_records;
+    uint64_t m_compactions;
+};
+
+} // end namespace vo
+
+#endif